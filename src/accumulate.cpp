@@ -0,0 +1,163 @@
+#include <algorithm>
+
+#include "accumulate.hpp"
+
+namespace optimizer {
+
+    /** Collects the variables that are declared or accumulated by
+     * statements */
+    class AccumulationFinder : public AST_Rewriter
+    {
+        public:
+            AccumulationFinder()
+                : AST_Rewriter(nullptr), accumulated(), declared() {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(VariableDeclaration *p) {
+                declared.insert(p->variable());
+                AST_Rewriter::visit(p);
+            }
+
+            virtual void visit(VariableAssignment *p) {
+                auto v = p->variable();
+
+                if (!accumulated_parts(p).empty() &&
+                        find(accumulated.begin(), accumulated.end(), v) ==
+                        accumulated.end())
+                    accumulated.push_back(v);
+                AST_Rewriter::visit(p);
+            }
+
+            vector<symbol::Variable *> accumulated;
+            set<symbol::Symbol *> declared;
+    };
+
+    /** Checks that a variable is only used by accumulations (and, for lists,
+     * as the object of method calls), and collects the accumulations */
+    class AccumulationChecker : public AST_Rewriter
+    {
+        public:
+            AccumulationChecker(symbol::Variable *v)
+                : AST_Rewriter(nullptr), valid(true), assignments(),
+                  variable_(v) {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(SymbolRef *p) {
+                if (p->symbol() == variable_)
+                    valid = false;
+            }
+
+            virtual void visit(MethodCall *p) {
+                SymbolRef *r = p->expression()->symbol_ref();
+
+                /* The list methods return new values */
+                if (r && r->symbol() == variable_ &&
+                        variable_->get_type()->list())
+                    rewrite_list(p->arguments());
+                else
+                    AST_Rewriter::visit(p);
+            }
+
+            virtual void visit(VariableAssignment *p) {
+                if (p->variable() != variable_) {
+                    AST_Rewriter::visit(p);
+                    return;
+                }
+
+                auto parts = accumulated_parts(p);
+                if (parts.empty())
+                    valid = false;
+                assignments.push_back(p);
+                for (auto e : parts)
+                    e->accept(*this);
+            }
+
+            bool valid;
+            vector<VariableAssignment *> assignments;
+        private:
+            AccumulationChecker(const AccumulationChecker &) = delete;
+            AccumulationChecker &operator=(
+                const AccumulationChecker &) = delete;
+
+            symbol::Variable *variable_;
+    };
+
+    vector<Expression *> accumulated_parts(VariableAssignment *p)
+    {
+        vector<Expression *> parts;
+        Expression *e = p->expression();
+        StringJoin *j = e->string_join();
+
+        if (j) {
+            SymbolRef *r = j->parts()->expression->symbol_ref();
+
+            if (r && r->symbol() == p->variable()) {
+                for (auto l = j->parts()->next; l != nullptr; l = l->next)
+                    parts.push_back(l->expression);
+            }
+            return parts;
+        }
+
+        for (;;) {
+            BinaryExpression *b = e->string_concat();
+            if (!b)
+                b = e->list_concat();
+            if (!b)
+                return vector<Expression *>();
+
+            parts.insert(parts.begin(), b->rhs());
+
+            SymbolRef *r = b->lhs()->symbol_ref();
+            if (r && r->symbol() == p->variable())
+                return parts;
+            e = b->lhs();
+        }
+    }
+
+    void InPlaceAccumulation::visit(ForEach *p)
+    {
+        collect(p, p->expression(), p->accumulators());
+        for (auto v : p->accumulators())
+            outer_.insert(v);
+        AST_Rewriter::visit(p);
+        for (auto v : p->accumulators())
+            outer_.erase(v);
+    }
+
+    void InPlaceAccumulation::visit(ForEachEnum *p)
+    {
+        collect(p, p->expression(), p->accumulators());
+        for (auto v : p->accumulators())
+            outer_.insert(v);
+        AST_Rewriter::visit(p);
+        for (auto v : p->accumulators())
+            outer_.erase(v);
+    }
+
+    void InPlaceAccumulation::collect(Scope *loop, Expression *e,
+                                      vector<symbol::Variable *> &accumulators)
+    {
+        if (!loop->statements())
+            return;
+
+        AccumulationFinder f;
+        loop->statements()->accept(f);
+
+        auto read = free_symbols(e);
+        for (auto v : f.accumulated) {
+            if (outer_.count(v) || f.declared.count(v) || read.count(v))
+                continue;
+
+            AccumulationChecker c(v);
+            loop->statements()->accept(c);
+            if (!c.valid)
+                continue;
+
+            for (auto a : c.assignments)
+                a->set_accumulate(true);
+            accumulators.push_back(v);
+        }
+    }
+}
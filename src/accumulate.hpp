@@ -0,0 +1,55 @@
+#ifndef __ACCUMULATE_H__
+#define __ACCUMULATE_H__
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** Returns the expressions appended to the variable by an assignment on
+     * the form x = x + a + b + ... (a chain of concatenations or a
+     * StringJoin), or an empty vector if the assignment isn't on that
+     * form */
+    vector<Expression *> accumulated_parts(VariableAssignment *);
+
+    /** InPlaceAccumulation class
+     *
+     * Finds string and list variables that are built up in for loops:
+     *
+     *   ~~~
+     *   % with names = []
+     *   % for f in files
+     *   % with names = names + [f.name]
+     *   % endfor
+     *   ~~~
+     *
+     * Copying the accumulated value in every iteration makes the loop
+     * quadratic. The assignments are instead marked as accumulations (and the
+     * variables are added to the accumulators of the outermost loop that they
+     * are accumulated in), which lets the backends append to the value in
+     * place.
+     *
+     * @details A variable is only accumulated if it's declared outside the
+     * loop, isn't read by the loop expression, and isn't assigned in any
+     * other way in the loop. A string may not be read at all in the loop,
+     * while a list may only be read as the object of a method call, since
+     * nothing else may observe (or keep a reference to) the partial value.
+     */
+    class InPlaceAccumulation : public AST_Rewriter
+    {
+        public:
+            InPlaceAccumulation(symbol::SymbolTable *t)
+                : AST_Rewriter(t), outer_() {}
+
+            using AST_Rewriter::visit;
+            virtual void visit(ForEach *);
+            virtual void visit(ForEachEnum *);
+        private:
+            void collect(Scope *, Expression *,
+                         vector<symbol::Variable *> &);
+
+            /* The variables accumulated by the surrounding loops */
+            set<symbol::Symbol *> outer_;
+    };
+}
+
+#endif
@@ -33,6 +33,9 @@ namespace ast {
     GENERATE_ACCEPT(List)
     GENERATE_ACCEPT(Record)
     GENERATE_ACCEPT(FunctionCall)
+    GENERATE_ACCEPT(Pipeline)
+    GENERATE_ACCEPT(StringJoin)
+    GENERATE_ACCEPT(Dict)
 
     GENERATE_ACCEPT(LambdaExpression)
     GENERATE_ACCEPT(FuncArgExpression)
@@ -52,4 +55,9 @@ namespace ast {
     GENERATE_ACCEPT(VariableDeclaration)
     GENERATE_ACCEPT(VariableAssignment)
     GENERATE_ACCEPT(Create)
+    GENERATE_ACCEPT(Macro)
+    GENERATE_ACCEPT(MacroCall)
+    GENERATE_ACCEPT(Memo)
+    GENERATE_ACCEPT(Break)
+    GENERATE_ACCEPT(Continue)
 }
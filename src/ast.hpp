@@ -62,6 +62,9 @@ namespace ast {
     class List;
     class Record;
     class FunctionCall;
+    class Pipeline;
+    class StringJoin;
+    class Dict;
     class ExpressionList;
 
     class LambdaExpression;
@@ -85,6 +88,11 @@ namespace ast {
     class VariableDeclaration;
     class VariableAssignment;
     class Create;
+    class Macro;
+    class MacroCall;
+    class Memo;
+    class Break;
+    class Continue;
 
 
     /** Abstract expression base class
@@ -96,6 +104,48 @@ namespace ast {
     {
         public:
             virtual const Type *type() const = 0;
+
+            /* Safe casters, returns nullptr if the expression is of another
+             * class */
+            virtual Constant *constant() {
+                return nullptr;
+            }
+            virtual Equals *equals() {
+                return nullptr;
+            }
+            virtual StringEquals *string_equals() {
+                return nullptr;
+            }
+            virtual SymbolRef *symbol_ref() {
+                return nullptr;
+            }
+            virtual FieldRef *field_ref() {
+                return nullptr;
+            }
+            virtual MethodCall *method_call() {
+                return nullptr;
+            }
+            virtual FunctionCall *function_call() {
+                return nullptr;
+            }
+            virtual StringRepeat *string_repeat() {
+                return nullptr;
+            }
+            virtual StringConcat *string_concat() {
+                return nullptr;
+            }
+            virtual ListConcat *list_concat() {
+                return nullptr;
+            }
+            virtual List *list() {
+                return nullptr;
+            }
+            virtual Pipeline *pipeline() {
+                return nullptr;
+            }
+            virtual StringJoin *string_join() {
+                return nullptr;
+            }
     };
 
     /**
@@ -118,6 +168,15 @@ namespace ast {
             Expression *rhs() {
                 return rhs_;
             }
+
+            void set_lhs(Expression *e) {
+                assert(e->type() == lhs_->type());
+                lhs_ = e;
+            }
+            void set_rhs(Expression *e) {
+                assert(e->type() == rhs_->type());
+                rhs_ = e;
+            }
         protected:
             Expression *lhs_;
             Expression *rhs_;
@@ -193,6 +252,19 @@ namespace ast {
             Expression *if_false() {
                 return if_false_;
             }
+
+            void set_condition(Expression *e) {
+                assert(e->type() == cond_->type());
+                cond_ = e;
+            }
+            void set_if_true(Expression *e) {
+                assert(e->type() == type_);
+                if_true_ = e;
+            }
+            void set_if_false(Expression *e) {
+                assert(e->type() == type_);
+                if_false_ = e;
+            }
         private:
             TernaryIf(const TernaryIf &) = delete;
             TernaryIf &operator=(const TernaryIf &) = delete;
@@ -249,6 +321,11 @@ namespace ast {
             Expression *expression() {
                 return expression_;
             }
+
+            void set_expression(Expression *e) {
+                assert(e->type() == type_);
+                expression_ = e;
+            }
         private:
             Not(const Not &) = delete;
             Not &operator=(const Not &) = delete;
@@ -356,6 +433,10 @@ namespace ast {
             Equals(Expression *lhs, Expression *rhs)
                 : IntCompare(lhs, rhs) {}
 
+            virtual Equals *equals() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
     };
 
@@ -511,6 +592,10 @@ namespace ast {
             StringEquals(Expression *lhs, Expression *rhs)
                 : StringCompare(lhs, rhs) {}
 
+            virtual StringEquals *string_equals() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
     };
 
@@ -528,6 +613,10 @@ namespace ast {
                 assert(mult->type() == TypeFactory::get("int"));
             }
 
+            virtual StringRepeat *string_repeat() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
             virtual const Type *type() const {
                 return type_;
@@ -553,6 +642,10 @@ namespace ast {
                 assert(rhs->type() == type_);
             }
 
+            virtual StringConcat *string_concat() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
             virtual const Type *type() const {
                 return type_;
@@ -578,6 +671,10 @@ namespace ast {
                 assert(lhs->type()->list() != nullptr);
             }
 
+            virtual ListConcat *list_concat() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
             virtual const Type *type() const {
                 return type_;
@@ -606,6 +703,10 @@ namespace ast {
                 return data_;
             }
 
+            virtual Constant *constant() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
             virtual const Type *type() const {
                 return data_->type();
@@ -634,6 +735,10 @@ namespace ast {
                 return symbol_;
             }
 
+            virtual SymbolRef *symbol_ref() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
             virtual const Type *type() const {
                 return symbol_->get_type();
@@ -662,6 +767,15 @@ namespace ast {
                 return field_;
             }
 
+            void set_record(Expression *e) {
+                assert(e->type() == record_->type());
+                record_ = e;
+            }
+
+            virtual FieldRef *field_ref() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
             virtual const Type *type() const {
                 return record_->type()->dot(field_);
@@ -843,6 +957,22 @@ namespace ast {
                 return return_value;
             }
 
+            virtual FunctionCall *function_call() {
+                return this;
+            }
+
+            /** Returns true if the function folds a list to a single value
+             * with a lambda expression that is applied on every element,
+             * i.e. sum(), count(), any(), all(), min() or max() */
+            bool aggregation() const {
+                return is_aggregation(name);
+            }
+
+            static bool is_aggregation(const string &n) {
+                return n == "sum" || n == "count" || n == "any" ||
+                       n == "all" || n == "min" || n == "max";
+            }
+
             ~FunctionCall() {
             }
 
@@ -900,6 +1030,15 @@ namespace ast {
             ExpressionList *arguments() {
                 return args_;
             }
+
+            void set_expression(Expression *e) {
+                assert(e->type() == expression_->type());
+                expression_ = e;
+            }
+
+            virtual MethodCall *method_call() {
+                return this;
+            }
         private:
             MethodCall(const MethodCall &) = delete;
             MethodCall &operator=(const MethodCall &) = delete;
@@ -909,6 +1048,148 @@ namespace ast {
             ExpressionList *args_;
     };
 
+    /** Pipeline class
+     *
+     * A Pipeline is a fused chain of map() and filter() calls on a list,
+     * optionally followed by a sort() and a join() or size():
+     *
+     *   ~~~
+     *   map(^string s: s.upper(), filter(^string s: s != "", l)).join(",")
+     *   ~~~
+     *
+     * @details The pipeline is created by the optimizer from FunctionCall and
+     * MethodCall nodes, so that backends can generate a single traversal of
+     * the source list without any intermediate lists.
+     */
+    class Pipeline : public UnaryExpression
+    {
+        public:
+            enum StageKind {
+                MAP,
+                FILTER
+            };
+
+            struct Stage
+            {
+                StageKind kind;
+                LambdaExpression *lambda;
+            };
+
+            Pipeline(Expression *source)
+                : source_(source), stages_(), sort_(nullptr),
+                  reduce_(), reduce_args_(nullptr), type_(source->type()) {
+                assert(type_->list() != nullptr);
+            }
+
+            /** Adds a map() or filter() stage. The lambda's expression must
+             * be of type bool for filters */
+            void add_stage(StageKind k, LambdaExpression *l, const Type *t) {
+                assert(sort_ == nullptr && reduce_.empty());
+                stages_.push_back(Stage{k, l});
+                type_ = t;
+            }
+            /** Sorts the result (the arguments are the arguments of the list
+             * type's sort method) */
+            void set_sort(ExpressionList *args) {
+                assert(sort_ == nullptr && reduce_.empty());
+                sort_ = args;
+            }
+            /** Reduces the result with the list method named n */
+            void set_reduce(const string &n, ExpressionList *args,
+                            const Type *t) {
+                assert(reduce_.empty());
+                reduce_ = n;
+                reduce_args_ = args;
+                type_ = t;
+            }
+
+            Expression *source() {
+                return source_;
+            }
+            void set_source(Expression *e) {
+                assert(e->type() == source_->type());
+                source_ = e;
+            }
+            vector<Stage> &stages() {
+                return stages_;
+            }
+            ExpressionList *sort() {
+                return sort_;
+            }
+            string reduce() const {
+                return reduce_;
+            }
+            ExpressionList *reduce_arguments() {
+                return reduce_args_;
+            }
+
+            /** Returns true if more stages can be added */
+            bool open() const {
+                return sort_ == nullptr && reduce_.empty();
+            }
+
+            virtual Pipeline *pipeline() {
+                return this;
+            }
+
+            virtual void accept(AST_Visitor &);
+            virtual const Type *type() const {
+                return type_;
+            }
+        private:
+            Pipeline(const Pipeline &) = delete;
+            Pipeline &operator=(const Pipeline &) = delete;
+
+            Expression *source_;
+            vector<Stage> stages_;
+            ExpressionList *sort_;
+            string reduce_;
+            ExpressionList *reduce_args_;
+            const Type *type_;
+    };
+
+    /** StringJoin class
+     *
+     * A StringJoin is the concatenation of any number of strings, i.e. a
+     * flattened chain of StringConcat nodes:
+     *
+     *   ~~~
+     *   name + " (" + mail + ")"
+     *   ~~~
+     *
+     * @details The node is created by the optimizer, so that backends can
+     * build the string in one operation instead of creating every
+     * intermediate string.
+     */
+    class StringJoin : public UnaryExpression
+    {
+        public:
+            StringJoin(ExpressionList *parts)
+                : parts_(parts) {}
+
+            ~StringJoin() {
+                delete parts_;
+            }
+
+            ExpressionList *parts() {
+                return parts_;
+            }
+
+            virtual StringJoin *string_join() {
+                return this;
+            }
+
+            virtual void accept(AST_Visitor &);
+            virtual const Type *type() const {
+                return TypeFactory::get("string");
+            }
+        private:
+            StringJoin(const StringJoin &) = delete;
+            StringJoin &operator=(const StringJoin &) = delete;
+
+            ExpressionList *parts_;
+    };
+
     /** List class
      *
      */
@@ -930,6 +1211,10 @@ namespace ast {
                 return elems_;
             }
 
+            virtual List *list() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
             virtual const ListType *type() const {
                 return type_;
@@ -980,13 +1265,78 @@ namespace ast {
             ExpressionList *fields_;
     };
 
+    /** Dict class
+     *
+     * A dictionary literal, e.g. string->int{"a": 1, "b": 2}. The keys and
+     * the values are held by two lists of the same length
+     */
+    class Dict : public UnaryExpression
+    {
+        public:
+            Dict(const DictType *t)
+                : type_(t), keys_(nullptr), values_(nullptr) {}
+
+            ~Dict() {
+                if (keys_)
+                    delete keys_;
+                if (values_)
+                    delete values_;
+            }
+
+            void set_entries(ExpressionList *k, ExpressionList *v) {
+                keys_ = k;
+                values_ = v;
+            }
+            ExpressionList *keys() {
+                return keys_;
+            }
+            ExpressionList *values() {
+                return values_;
+            }
+
+            virtual void accept(AST_Visitor &);
+            virtual const DictType *type() const {
+                return type_;
+            }
+        private:
+            Dict(const Dict &) = delete;
+            Dict &operator=(const Dict &) = delete;
+
+            const DictType *type_;
+            ExpressionList *keys_;
+            ExpressionList *values_;
+    };
+
 
     /** Statement class
      *
      */
     class Statement : public AST_Node
     {
+        public:
+            Statement()
+                : line_(0) {}
+
+            /* Safe casters, returns nullptr if the statement is of another
+             * class */
+            virtual Conditional *conditional() {
+                return nullptr;
+            }
+            virtual VariableList *variable_list() {
+                return nullptr;
+            }
 
+            /** Returns the line in the source file where the statement
+             * starts, or 0 if it's not known (e.g. for statements created
+             * by the optimizer) */
+            int line() const {
+                return line_;
+            }
+            void set_line(int l) {
+                line_ = l;
+            }
+        private:
+            int line_;
     };
 
     /** Conditional class
@@ -996,10 +1346,15 @@ namespace ast {
     {
         public:
             Conditional(If *if_node, Elif *elif_nodes, Else *else_node)
-                : if_(if_node), elifs_(elif_nodes), else_(else_node) {}
+                : if_(if_node), elifs_(elif_nodes), else_(else_node),
+                  subject_(nullptr), keys_() {}
 
             virtual void accept(AST_Visitor &);
 
+            virtual Conditional *conditional() {
+                return this;
+            }
+
             If *if_node() {
                 return if_;
             }
@@ -1009,6 +1364,33 @@ namespace ast {
             Else *else_node() {
                 return else_;
             }
+
+            void set_if_node(If *p) {
+                if_ = p;
+            }
+            void set_elif_nodes(Elif *p) {
+                elifs_ = p;
+            }
+            void set_else_node(Else *p) {
+                else_ = p;
+            }
+
+            /** Marks the conditional as a dispatch on the value of the
+             * subject: the condition of the if node, and of each elif node,
+             * compares the subject with the corresponding key */
+            void set_dispatch(Expression *subject,
+                              const vector<Constant *> &keys) {
+                subject_ = subject;
+                keys_ = keys;
+            }
+            /** Returns the subject of the dispatch, or nullptr if the
+             * conditional isn't a dispatch */
+            Expression *dispatch_subject() {
+                return subject_;
+            }
+            const vector<Constant *> &dispatch_keys() const {
+                return keys_;
+            }
         private:
             Conditional(const Conditional &) = delete;
             Conditional &operator=(const Conditional &) = delete;
@@ -1016,6 +1398,8 @@ namespace ast {
             If *if_;
             Elif *elifs_;
             Else *else_;
+            Expression *subject_;
+            vector<Constant *> keys_;
     };
 
     /** Scope class
@@ -1071,7 +1455,8 @@ namespace ast {
                 : Scope(t, nullptr), expression_(e), for_table_(ft),
                   variable_(sy),
                   loop_variable_(symbol::Variable::create("loop",
-                                 TypeFactory::get("loop"), true, true)) {
+                                 TypeFactory::get("loop"), true, true)),
+                  accumulators_() {
                 ft->add(loop_variable_);
             }
 
@@ -1086,6 +1471,22 @@ namespace ast {
                 return loop_variable_;
             }
 
+            /** Returns the symbol table holding the loop variables */
+            symbol::SymbolTable *for_table() {
+                return for_table_;
+            }
+
+            void set_expression(Expression *e) {
+                assert(e->type() == expression_->type());
+                expression_ = e;
+            }
+
+            /** Returns the variables that are accumulated in place in the
+             * loop (see VariableAssignment::accumulate()) */
+            vector<symbol::Variable *> &accumulators() {
+                return accumulators_;
+            }
+
             virtual void accept(AST_Visitor &);
         private:
             ForEach(const ForEach &) = delete;
@@ -1096,6 +1497,7 @@ namespace ast {
             symbol::Variable *variable_;
 
             symbol::Variable *loop_variable_;
+            vector<symbol::Variable *> accumulators_;
     };
 
     /** ForEachEnum class
@@ -1119,7 +1521,7 @@ namespace ast {
                         symbol::SymbolTable *ft,
                         symbol::SymbolTable *t)
                 : Scope(t, nullptr), expression_(e), for_table_(ft),
-                  index_(i), value_(v) {}
+                  index_(i), value_(v), accumulators_() {}
 
             Expression *expression() {
                 return expression_;
@@ -1133,6 +1535,22 @@ namespace ast {
                 return value_;
             }
 
+            /** Returns the symbol table holding the loop variables */
+            symbol::SymbolTable *for_table() {
+                return for_table_;
+            }
+
+            void set_expression(Expression *e) {
+                assert(e->type() == expression_->type());
+                expression_ = e;
+            }
+
+            /** Returns the variables that are accumulated in place in the
+             * loop (see VariableAssignment::accumulate()) */
+            vector<symbol::Variable *> &accumulators() {
+                return accumulators_;
+            }
+
             virtual void accept(AST_Visitor &);
         private:
             ForEachEnum(const ForEachEnum &) = delete;
@@ -1142,6 +1560,7 @@ namespace ast {
             symbol::SymbolTable *for_table_;
             symbol::Variable *index_;
             symbol::Variable *value_;
+            vector<symbol::Variable *> accumulators_;
     };
 
     /** If class
@@ -1212,6 +1631,45 @@ namespace ast {
             virtual void accept(AST_Visitor &);
     };
 
+    /** Memo class
+     *
+     * Memo represents a memo block:
+     *   ~~~
+     *   % memo [expression]
+     *     [statements]
+     *   % endmemo
+     *   ~~~
+     *
+     * @details The output of the statements is cached by the value of the
+     * key expression. When the block is evaluated with a key that it has
+     * been evaluated with before, the cached output is written instead of
+     * running the statements again. The statements may therefore only depend
+     * on the key and on values that don't change between the evaluations
+     * (see memo::check()).
+     */
+    class Memo : public Scope
+    {
+        public:
+            Memo(Expression *k, symbol::SymbolTable *t)
+                : Scope(t, nullptr), key_(k) {}
+
+            Expression *key() {
+                return key_;
+            }
+
+            void set_key(Expression *k) {
+                assert(k->type() == key_->type());
+                key_ = k;
+            }
+
+            virtual void accept(AST_Visitor &);
+        private:
+            Memo(const Memo &) = delete;
+            Memo &operator=(const Memo &) = delete;
+
+            Expression *key_;
+    };
+
     /** Raw text
      *
      * The Text class holds raw text (in UTF-8 format)
@@ -1249,6 +1707,10 @@ namespace ast {
                 return expression_;
             }
 
+            void set_expression(Expression *e) {
+                expression_ = e;
+            }
+
             virtual void accept(AST_Visitor &);
         private:
             InlinedExpression(const InlinedExpression &) = delete;
@@ -1265,6 +1727,12 @@ namespace ast {
     {
         public:
             virtual symbol::Variable *variable() = 0;
+
+            /* Safe caster, returns nullptr if the statement is an
+             * assignment */
+            virtual VariableDeclaration *declaration() {
+                return nullptr;
+            }
     };
 
     /** VariableList class
@@ -1286,6 +1754,10 @@ namespace ast {
             VariableStatement *statement;
             VariableList *next;
 
+            virtual VariableList *variable_list() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
         private:
             VariableList(const VariableList &) = delete;
@@ -1299,7 +1771,7 @@ namespace ast {
     {
         public:
             VariableAssignment(symbol::Variable *v, Expression *e)
-                : variable_(v), expression_(e) {}
+                : variable_(v), expression_(e), accumulate_(false) {}
 
             ~VariableAssignment() {
                 delete expression_;
@@ -1313,6 +1785,21 @@ namespace ast {
                 return expression_;
             }
 
+            void set_expression(Expression *e) {
+                assert(e->type() == variable_->get_type());
+                expression_ = e;
+            }
+
+            /** Returns true if the assignment is on the form x = x + ... and
+             * may be generated as an in-place append to x. The loop that x
+             * is accumulated in lists x in its accumulators() */
+            bool accumulate() const {
+                return accumulate_;
+            }
+            void set_accumulate(bool a) {
+                accumulate_ = a;
+            }
+
             virtual void accept(AST_Visitor &);
         private:
             VariableAssignment(const VariableAssignment &) = delete;
@@ -1321,6 +1808,7 @@ namespace ast {
 
             symbol::Variable *variable_;
             Expression *expression_;
+            bool accumulate_;
     };
 
     /** VariableDeclaration class
@@ -1351,6 +1839,10 @@ namespace ast {
                 return assignment_;
             }
 
+            virtual VariableDeclaration *declaration() {
+                return this;
+            }
+
             virtual void accept(AST_Visitor &);
         private:
             VariableDeclaration(const VariableDeclaration &) = delete;
@@ -1374,7 +1866,8 @@ namespace ast {
         public:
             Create(Expression *out, const string &tgl, bool ow_ask,
                    const map<string, Expression *> &kw)
-                : out(out), tgl(tgl), ow_ask(ow_ask), args(kw) {}
+                : out(out), tgl(tgl), ow_ask(ow_ask), args(kw),
+                  rendered(false), text() {}
 
             virtual void accept(AST_Visitor &);
 
@@ -1382,11 +1875,128 @@ namespace ast {
             string tgl;
             bool ow_ask;
             map<string, Expression *> args;
+
+            /* Set if the file has been rendered at compile time, in which
+             * case text holds the content of the file */
+            bool rendered;
+            string text;
         private:
             Create(const Create &) = delete;
             Create &operator=(const Create &) = delete;
     };
 
+    /** Macro class
+     *
+     * Macro represents a macro definition, which can only be made at the top
+     * level of a body:
+     *   ~~~
+     *   % macro [identifier]([type] [identifier], ...)
+     *     [statements]
+     *   % endmacro
+     *   ~~~
+     *
+     * @details The statements can only refer to the parameters and to the
+     * arguments of the file, so the backends can generate the macro once as a
+     * function that writes to the current output.
+     */
+    class Macro : public Scope
+    {
+        public:
+            Macro(const string &name, symbol::SymbolTable *pt,
+                  symbol::SymbolTable *t)
+                : Scope(t, nullptr), name_(name), params_(),
+                  params_table_(pt) {}
+
+            string name() const {
+                return name_;
+            }
+
+            vector<symbol::Variable *> &params() {
+                return params_;
+            }
+
+            /** Returns the symbol table holding the parameters (and the
+             * arguments of the file) */
+            symbol::SymbolTable *params_table() {
+                return params_table_;
+            }
+
+            virtual void accept(AST_Visitor &);
+        private:
+            Macro(const Macro &) = delete;
+            Macro &operator=(const Macro &) = delete;
+
+            string name_;
+            vector<symbol::Variable *> params_;
+            symbol::SymbolTable *params_table_;
+    };
+
+    /** MacroCall class
+     *
+     * MacroCall represents a call to a macro, either as the whole expression
+     * of an inlined expression or with % call. The output of the macro is
+     * written in place of the call
+     */
+    class MacroCall : public Statement
+    {
+        public:
+            MacroCall(Macro *m, ExpressionList *a)
+                : macro_(m), arguments_(a) {}
+
+            ~MacroCall() {
+                if (arguments_)
+                    delete arguments_;
+            }
+
+            Macro *macro() {
+                return macro_;
+            }
+
+            /** Returns the arguments, one for each parameter */
+            ExpressionList *arguments() {
+                return arguments_;
+            }
+
+            virtual void accept(AST_Visitor &);
+        private:
+            MacroCall(const MacroCall &) = delete;
+            MacroCall &operator=(const MacroCall &) = delete;
+
+            Macro *macro_;
+            ExpressionList *arguments_;
+    };
+
+    /** Break class
+     *
+     * Break represents a % break statement, which leaves the innermost loop
+     */
+    class Break : public Statement
+    {
+        public:
+            Break() = default;
+
+            virtual void accept(AST_Visitor &);
+        private:
+            Break(const Break &) = delete;
+            Break &operator=(const Break &) = delete;
+    };
+
+    /** Continue class
+     *
+     * Continue represents a % continue statement, which skips the rest of
+     * the current iteration of the innermost loop
+     */
+    class Continue : public Statement
+    {
+        public:
+            Continue() = default;
+
+            virtual void accept(AST_Visitor &);
+        private:
+            Continue(const Continue &) = delete;
+            Continue &operator=(const Continue &) = delete;
+    };
+
     /** Statements class
      *
      * Statements represents a list of statements. A Statements object holds a
@@ -1412,6 +2022,13 @@ namespace ast {
             Statements *next() {
                 return next_;
             }
+
+            void set_statement(Statement *s) {
+                statement_ = s;
+            }
+            void set_next(Statements *n) {
+                next_ = n;
+            }
         private:
             Statements(const Statements &) = delete;
             Statements &operator=(const Statements &) = delete;
@@ -1456,6 +2073,9 @@ namespace ast {
             virtual void visit(FieldRef *) = 0;
             virtual void visit(List *) = 0;
             virtual void visit(Record *) = 0;
+            virtual void visit(Pipeline *) = 0;
+            virtual void visit(StringJoin *) = 0;
+            virtual void visit(Dict *) = 0;
 
             virtual void visit(LambdaExpression *) {}
             /* TODO */
@@ -1478,6 +2098,11 @@ namespace ast {
             virtual void visit(VariableDeclaration *) = 0;
             virtual void visit(VariableAssignment *) = 0;
             virtual void visit(Create *) = 0;
+            virtual void visit(Macro *) = 0;
+            virtual void visit(MacroCall *) = 0;
+            virtual void visit(Memo *) = 0;
+            virtual void visit(Break *) = 0;
+            virtual void visit(Continue *) = 0;
     };
 }
 
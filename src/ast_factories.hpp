@@ -22,7 +22,8 @@ namespace ast_factory {
             } else if (e->type() == TypeFactory::get("string")) {
                 auto empty = new StringConstantData("");
                 return new Not(new StringEquals(e, new Constant(empty)));
-            } else if (e->type()->list()) {
+            } else if (e->type()->list() || e->type()->dict() ||
+                       e->type()->set()) {
                 TypeMethod m = e->type()->lookup("size");
                 return new GreaterThan(new MethodCall(e, m),
                                        new Constant(new IntConstantData(0)));
@@ -113,7 +114,8 @@ namespace ast_factory {
         {
             if (e->type() == TypeFactory::get("string"))
                 return new MethodCall(e, e->type()->lookup("length"));
-            else if (e->type()->list())
+            else if (e->type()->list() || e->type()->dict() ||
+                     e->type()->set())
                 return new MethodCall(e, e->type()->lookup("size"));
 
             throw InvalidTypeError("Can't apply '#' operand on " +
@@ -121,6 +123,81 @@ namespace ast_factory {
         }
     };
 
+    /** Creates a membership test (x in s), as a has() call on the set or
+     * dictionary
+     *
+     */
+    struct InFactory
+    {
+        static Expression *create(Expression *e, Expression *container)
+        {
+            auto t = container->type();
+            const Type *elem = nullptr;
+
+            if (t->set())
+                elem = t->set()->elem();
+            else if (t->dict())
+                elem = t->dict()->key();
+            else
+                throw InvalidTypeError("Can't apply 'in' operand on " +
+                                       t->str() + " (expected a set or a "
+                                       "dictionary)");
+
+            if (e->type() != elem)
+                throw InvalidTypeError("Can't test if " + e->type()->str() +
+                                       " is in " + t->str());
+
+            return new MethodCall(container, t->lookup("has", { elem }),
+                                  new ExpressionList(e));
+        }
+    };
+
+    /** Creates an element access (xs[i]) or a slice (xs[a:b], xs[a:] or
+     * xs[:b]) of a list, as an at(), slice() or from() call on the list
+     *
+     */
+    struct IndexFactory
+    {
+        static Expression *create(Expression *e, Expression *i)
+        {
+            check(e, i);
+            return new MethodCall(e, e->type()->lookup("at", { i->type() }),
+                                  new ExpressionList(i));
+        }
+
+        /** Creates a slice. A missing start is 0, and a missing end is the
+         * end of the list */
+        static Expression *create(Expression *e, Expression *from,
+                                  Expression *to)
+        {
+            if (from == nullptr)
+                from = new Constant(new IntConstantData(0));
+            check(e, from);
+
+            if (to == nullptr) {
+                return new MethodCall(e, e->type()->lookup("from",
+                                      { from->type() }),
+                                      new ExpressionList(from));
+            }
+
+            check(e, to);
+            return new MethodCall(e, e->type()->lookup("slice",
+                                  { from->type(), to->type() }),
+                                  new ExpressionList(from,
+                                                     new ExpressionList(to)));
+        }
+    private:
+        static void check(Expression *e, Expression *i)
+        {
+            if (!e->type()->list())
+                throw InvalidTypeError("Can't index expression of type " +
+                                       e->type()->str());
+            if (i->type() != TypeFactory::get("int"))
+                throw InvalidTypeError("List indices must be of type int "
+                                       "(got " + i->type()->str() + ")");
+        }
+    };
+
     /** Creates a minus expression
      *
      */
@@ -376,6 +453,151 @@ namespace ast_factory {
 
                 return new ast::FunctionCall(name,
                                              TypeFactory::get_list(ret_elem), args);
+            } else if (name == "set") {
+                const ListType *list;
+                const PrimitiveType *elem;
+
+                if (!args || args->next || !(e0 = args->get_expression(0)) ||
+                        !(list = e0->type()->list()) ||
+                        !(elem = list->elem()->primitive()))
+                    throw WrongFunctionSignatureError("set",
+                                                      "list of primitives");
+
+                return new ast::FunctionCall(name, TypeFactory::get_set(elem),
+                                             args);
+            } else if (name == "unique") {
+                const ListType *list;
+
+                /* The elements are hashed, so records can't hold lists */
+                if (!args || args->next || !(e0 = args->get_expression(0)) ||
+                        !(list = e0->type()->list()) ||
+                        !(list->elem()->primitive() ||
+                          list->elem()->record()->flat()))
+                    throw WrongFunctionSignatureError("unique",
+                            "list of primitives or flat records");
+
+                return new ast::FunctionCall(name, list, args);
+            } else if (name == "distinct") {
+                const ListType *list;
+
+                if (!args || !(f = args->get_lambda(0)) ||
+                        !(e0 = args->get_expression(1)) ||
+                        !(list = e0->type()->list()))
+                    throw WrongFunctionSignatureError("distinct",
+                                                      "lambda function, list");
+
+                check_lambda(f, { list->elem() });
+
+                if (!f->expression->type()->primitive())
+                    throw InvalidTypeError("distinct() keys must be of a "
+                                           "primitive type (got " +
+                                           f->expression->type()->str() + ")");
+
+                return new ast::FunctionCall(name, list, args);
+            } else if (name == "index_by") {
+                const ListType *list;
+                const PrimitiveType *key;
+
+                if (!args || !(f = args->get_lambda(0)) ||
+                        !(e0 = args->get_expression(1)) ||
+                        !(list = e0->type()->list()))
+                    throw WrongFunctionSignatureError("index_by",
+                                                      "lambda function, list");
+
+                check_lambda(f, { list->elem() });
+
+                if (!(key = f->expression->type()->primitive()))
+                    throw InvalidTypeError("index_by() keys must be of a "
+                                           "primitive type (got " +
+                                           f->expression->type()->str() + ")");
+
+                return new ast::FunctionCall(name,
+                        TypeFactory::get_dict(key, list->elem()), args);
+            } else if (name == "group_by") {
+                const ListType *list;
+                const PrimitiveType *key;
+
+                if (!args || !(f = args->get_lambda(0)) ||
+                        !(e0 = args->get_expression(1)) ||
+                        !(list = e0->type()->list()))
+                    throw WrongFunctionSignatureError("group_by",
+                                                      "lambda function, list");
+
+                check_lambda(f, { list->elem() });
+
+                if (!(key = f->expression->type()->primitive()))
+                    throw InvalidTypeError("group_by() keys must be of a "
+                                           "primitive type (got " +
+                                           f->expression->type()->str() + ")");
+
+                auto group = TypeFactory::get_group(key, list->elem());
+                return new ast::FunctionCall(name,
+                                             TypeFactory::get_list(group),
+                                             args);
+            } else if (name == "zip") {
+                const ListType *a, *b;
+                Expression *e1;
+
+                if (!args || !(e0 = args->get_expression(0)) ||
+                        !(e1 = args->get_expression(1)) ||
+                        !(a = e0->type()->list()) ||
+                        !(b = e1->type()->list()))
+                    throw WrongFunctionSignatureError("zip", "list, list");
+
+                auto pair = TypeFactory::get_zip(a->elem(), b->elem());
+                return new ast::FunctionCall(name,
+                                             TypeFactory::get_list(pair),
+                                             args);
+            } else if (FunctionCall::is_aggregation(name)) {
+                const ListType *list;
+                const Type *t;
+
+                if (!args || !(f = args->get_lambda(0)) ||
+                        !(e0 = args->get_expression(1)) ||
+                        !(list = e0->type()->list()))
+                    throw WrongFunctionSignatureError(name,
+                                                      "lambda function, list");
+
+                check_lambda(f, { list->elem() });
+
+                if (name == "count" || name == "any" || name == "all") {
+                    /* Cast the predicate to bool, as for filter() */
+                    f->expression = BoolUnaryFactory::create(f->expression);
+                    t = TypeFactory::get(name == "count" ? "int" : "bool");
+                } else {
+                    t = f->expression->type();
+
+                    if (t != TypeFactory::get("int") && (name == "sum" ||
+                            t != TypeFactory::get("string")))
+                        throw InvalidTypeError(name + "() values must be of "
+                                               "type " + (name == "sum" ?
+                                               "int" : "int or string") +
+                                               " (got " + t->str() + ")");
+                }
+
+                return new ast::FunctionCall(name, t, args);
+            } else if (name == "reduce") {
+                const ListType *list;
+                Expression *init;
+
+                if (!args || !(f = args->get_lambda(0)) ||
+                        !(e0 = args->get_expression(1)) ||
+                        !(list = e0->type()->list()) ||
+                        !(init = args->get_expression(2)))
+                    throw WrongFunctionSignatureError("reduce",
+                            "lambda function, list, initial value");
+
+                check_lambda(f, { init->type(), list->elem() });
+
+                if (f->expression->type() != init->type())
+                    throw InvalidTypeError("reduce() lambda function must "
+                                           "return the type of the initial "
+                                           "value (got " +
+                                           f->expression->type()->str() +
+                                           ", expected " +
+                                           init->type()->str() + ")");
+
+                return new ast::FunctionCall(name, init->type(), args);
             } else {
                 throw NoSuchFunctionError(name);
             }
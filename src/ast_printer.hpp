@@ -172,6 +172,60 @@ namespace ast_printer {
                 indent--;
             }
 
+            virtual void visit(Pipeline *p) {
+                print_ws();
+                cerr << "Pipeline(" << p->type()->str() << ")\n";
+                indent++;
+                p->source()->accept(*this);
+                for (auto &s : p->stages()) {
+                    print_ws();
+                    cerr << (s.kind == Pipeline::MAP ? "Map\n" : "Filter\n");
+                    indent++;
+                    s.lambda->accept(*this);
+                    indent--;
+                }
+                if (p->sort()) {
+                    print_ws();
+                    cerr << "Sort\n";
+                    indent++;
+                    for (auto e = p->sort(); e != nullptr; e = e->next)
+                        e->expression->accept(*this);
+                    indent--;
+                }
+                if (!p->reduce().empty()) {
+                    print_ws();
+                    cerr << "Reduce(" << p->reduce() << ")\n";
+                    indent++;
+                    for (auto e = p->reduce_arguments(); e != nullptr;
+                            e = e->next)
+                        e->expression->accept(*this);
+                    indent--;
+                }
+                indent--;
+            }
+
+            virtual void visit(StringJoin *p) {
+                print_ws();
+                cerr << "StringJoin\n";
+                indent++;
+                for (auto e = p->parts(); e != nullptr; e = e->next)
+                    e->expression->accept(*this);
+                indent--;
+            }
+
+            virtual void visit(Dict *p) {
+                print_ws();
+                cerr << "Dict(" << p->type()->str() << ")\n";
+                indent++;
+                auto v = p->values();
+                for (auto k = p->keys(); k != nullptr; k = k->next) {
+                    k->expression->accept(*this);
+                    v->expression->accept(*this);
+                    v = v->next;
+                }
+                indent--;
+            }
+
             virtual void visit(LambdaExpression *p) {
                 print_ws();
                 cerr << "LambdaExpression(" << p->table << ")\n";
@@ -318,7 +372,10 @@ namespace ast_printer {
 
             virtual void visit(VariableAssignment *p) {
                 print_ws();
-                cerr << "VariableAssignment\n";
+                cerr << "VariableAssignment";
+                if (p->accumulate())
+                    cerr << " (in place)";
+                cerr << "\n";
                 indent++;
                 print_ws();
                 p->variable()->print(cerr);
@@ -356,6 +413,49 @@ namespace ast_printer {
                 indent--;
             }
 
+            virtual void visit(Macro *p) {
+                print_ws();
+                cerr << "Macro(name=" << p->name() << ")\n";
+                indent++;
+                for (auto v : p->params()) {
+                    print_ws();
+                    v->print(cerr);
+                    cerr << "\n";
+                }
+                if (p->statements())
+                    p->statements()->accept(*this);
+                indent--;
+            }
+
+            virtual void visit(MacroCall *p) {
+                print_ws();
+                cerr << "MacroCall(name=" << p->macro()->name() << ")\n";
+                indent++;
+                for (auto a = p->arguments(); a != nullptr; a = a->next)
+                    a->expression->accept(*this);
+                indent--;
+            }
+
+            virtual void visit(Memo *p) {
+                print_ws();
+                cerr << "Memo\n";
+                indent++;
+                p->key()->accept(*this);
+                if (p->statements())
+                    p->statements()->accept(*this);
+                indent--;
+            }
+
+            virtual void visit(Break *) {
+                print_ws();
+                cerr << "Break\n";
+            }
+
+            virtual void visit(Continue *) {
+                print_ws();
+                cerr << "Continue\n";
+            }
+
         private:
             void binary(const string &s, BinaryExpression *e)
             {
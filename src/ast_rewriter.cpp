@@ -0,0 +1,399 @@
+#include "ast_rewriter.hpp"
+
+namespace ast_rewriter {
+
+    void AST_Rewriter::visit(TernaryIf *p)
+    {
+        p->set_condition(rewrite(p->condition()));
+        p->set_if_true(rewrite(p->if_true()));
+        p->set_if_false(rewrite(p->if_false()));
+    }
+
+    void AST_Rewriter::visit(And *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(Or *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(Not *p)
+    {
+        p->set_expression(rewrite(p->expression()));
+    }
+
+    void AST_Rewriter::visit(BoolEquals *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(LessThan *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(LessThanOrEqual *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(GreaterThan *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(GreaterThanOrEqual *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(Equals *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(Plus *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(Minus *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(Times *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(StringLessThan *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(StringLessThanOrEqual *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(StringGreaterThan *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(StringGreaterThanOrEqual *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(StringEquals *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(StringRepeat *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(StringConcat *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(ListConcat *p)
+    {
+        binary(p);
+    }
+
+    void AST_Rewriter::visit(Constant *)
+    {
+
+    }
+
+    void AST_Rewriter::visit(MethodCall *p)
+    {
+        p->set_expression(rewrite(p->expression()));
+        rewrite_list(p->arguments());
+    }
+
+    void AST_Rewriter::visit(SymbolRef *)
+    {
+
+    }
+
+    void AST_Rewriter::visit(FieldRef *p)
+    {
+        p->set_record(rewrite(p->record()));
+    }
+
+    void AST_Rewriter::visit(List *p)
+    {
+        rewrite_list(p->elements());
+    }
+
+    void AST_Rewriter::visit(Record *p)
+    {
+        rewrite_list(p->fields());
+    }
+
+    void AST_Rewriter::visit(Pipeline *p)
+    {
+        p->set_source(rewrite(p->source()));
+        for (auto &s : p->stages())
+            s.lambda->accept(*this);
+        rewrite_list(p->sort());
+        rewrite_list(p->reduce_arguments());
+    }
+
+    void AST_Rewriter::visit(StringJoin *p)
+    {
+        rewrite_list(p->parts());
+    }
+
+    void AST_Rewriter::visit(Dict *p)
+    {
+        rewrite_list(p->keys());
+        rewrite_list(p->values());
+    }
+
+    void AST_Rewriter::visit(LambdaExpression *p)
+    {
+        tables_.push_back(p->table);
+        p->expression = rewrite(p->expression);
+        tables_.pop_back();
+    }
+
+    void AST_Rewriter::visit(FunctionCall *p)
+    {
+        if (p->args)
+            p->args->accept(*this);
+    }
+
+    void AST_Rewriter::visit(FuncArgList *p)
+    {
+        for (auto a = p; a != nullptr; a = a->next)
+            a->arg->accept(*this);
+    }
+
+    void AST_Rewriter::visit(FuncArgExpression *p)
+    {
+        p->value = rewrite(p->value);
+    }
+
+    void AST_Rewriter::visit(FuncArgLambda *p)
+    {
+        p->value->accept(*this);
+    }
+
+    Statements *AST_Rewriter::rewrite_block(Statements *p)
+    {
+        Statements *saved_cursor = cursor_;
+        Statements *saved_prev = prev_;
+        Statements *head = p;
+
+        prev_ = nullptr;
+        cursor_ = p;
+        while (cursor_ != nullptr) {
+            Statement *s = rewrite_statement(cursor_->statement());
+            Statements *next = cursor_->next();
+
+            if (s == nullptr) {
+                /* Unlink the removed statement */
+                if (prev_)
+                    prev_->set_next(next);
+                else
+                    head = next;
+                cursor_->set_statement(nullptr);
+                cursor_->set_next(nullptr);
+                delete cursor_;
+            } else {
+                cursor_->set_statement(s);
+                prev_ = cursor_;
+            }
+            cursor_ = next;
+        }
+
+        cursor_ = saved_cursor;
+        prev_ = saved_prev;
+        return head;
+    }
+
+    void AST_Rewriter::visit(Statements *p)
+    {
+        Statements *s = rewrite_block(p);
+        assert(s == p);
+        (void)s;
+    }
+
+    void AST_Rewriter::visit(Conditional *p)
+    {
+        p->if_node()->accept(*this);
+        if (p->elif_nodes())
+            p->elif_nodes()->accept(*this);
+        if (p->else_node())
+            p->else_node()->accept(*this);
+    }
+
+    void AST_Rewriter::visit(ForEach *p)
+    {
+        p->set_expression(rewrite(p->expression()));
+
+        tables_.push_back(p->for_table());
+        tables_.push_back(p->table());
+        if (p->statements())
+            p->set_statements(rewrite_block(p->statements()));
+        tables_.pop_back();
+        tables_.pop_back();
+    }
+
+    void AST_Rewriter::visit(ForEachEnum *p)
+    {
+        p->set_expression(rewrite(p->expression()));
+
+        tables_.push_back(p->for_table());
+        tables_.push_back(p->table());
+        if (p->statements())
+            p->set_statements(rewrite_block(p->statements()));
+        tables_.pop_back();
+        tables_.pop_back();
+    }
+
+    void AST_Rewriter::visit(If *p)
+    {
+        p->set_condition(rewrite(p->condition()));
+
+        tables_.push_back(p->table());
+        if (p->statements())
+            p->set_statements(rewrite_block(p->statements()));
+        tables_.pop_back();
+    }
+
+    void AST_Rewriter::visit(Elif *p)
+    {
+        p->set_condition(rewrite(p->condition()));
+
+        tables_.push_back(p->table());
+        if (p->statements())
+            p->set_statements(rewrite_block(p->statements()));
+        tables_.pop_back();
+
+        if (p->next())
+            p->next()->accept(*this);
+    }
+
+    void AST_Rewriter::visit(Else *p)
+    {
+        tables_.push_back(p->table());
+        if (p->statements())
+            p->set_statements(rewrite_block(p->statements()));
+        tables_.pop_back();
+    }
+
+    void AST_Rewriter::visit(Text *)
+    {
+
+    }
+
+    void AST_Rewriter::visit(InlinedExpression *p)
+    {
+        p->set_expression(rewrite(p->expression()));
+    }
+
+    void AST_Rewriter::visit(VariableList *p)
+    {
+        for (auto v = p; v != nullptr; v = v->next)
+            v->statement->accept(*this);
+    }
+
+    void AST_Rewriter::visit(VariableDeclaration *p)
+    {
+        if (p->assignment())
+            p->assignment()->accept(*this);
+    }
+
+    void AST_Rewriter::visit(VariableAssignment *p)
+    {
+        p->set_expression(rewrite(p->expression()));
+    }
+
+    void AST_Rewriter::visit(Create *p)
+    {
+        p->out = rewrite(p->out);
+        for (auto it = p->args.begin(); it != p->args.end(); ++it)
+            it->second = rewrite(it->second);
+    }
+
+    void AST_Rewriter::visit(Macro *p)
+    {
+        tables_.push_back(p->params_table());
+        tables_.push_back(p->table());
+        if (p->statements())
+            p->set_statements(rewrite_block(p->statements()));
+        tables_.pop_back();
+        tables_.pop_back();
+    }
+
+    void AST_Rewriter::visit(MacroCall *p)
+    {
+        rewrite_list(p->arguments());
+    }
+
+    void AST_Rewriter::visit(Memo *p)
+    {
+        p->set_key(rewrite(p->key()));
+
+        tables_.push_back(p->table());
+        if (p->statements())
+            p->set_statements(rewrite_block(p->statements()));
+        tables_.pop_back();
+    }
+
+    void AST_Rewriter::visit(Break *)
+    {
+
+    }
+
+    void AST_Rewriter::visit(Continue *)
+    {
+
+    }
+
+    bool AST_Rewriter::defined_in_tables(symbol::Symbol *s) const
+    {
+        for (auto t : tables_) {
+            if (t->contains(s))
+                return true;
+        }
+        return false;
+    }
+
+    void AST_Rewriter::insert_before(Statement *s)
+    {
+        assert(cursor_ != nullptr);
+
+        /* Move the current statement to a new node after the cursor, and let
+         * the cursor point at the new node so that the walk continues from
+         * the moved statement */
+        cursor_->set_next(new Statements(cursor_->statement(),
+                                         cursor_->next()));
+        cursor_->set_statement(s);
+        prev_ = cursor_;
+        cursor_ = cursor_->next();
+    }
+
+    void AST_Rewriter::binary(BinaryExpression *p)
+    {
+        p->set_lhs(rewrite(p->lhs()));
+        p->set_rhs(rewrite(p->rhs()));
+    }
+
+    void AST_Rewriter::rewrite_list(ExpressionList *l)
+    {
+        for (auto e = l; e != nullptr; e = e->next)
+            e->expression = rewrite(e->expression);
+    }
+}
@@ -0,0 +1,138 @@
+#ifndef __AST_REWRITER_H__
+#define __AST_REWRITER_H__
+
+#include <vector>
+
+using namespace std;
+
+#include "ast.hpp"
+#include "symbol.hpp"
+
+namespace ast_rewriter {
+
+    using namespace ast;
+
+    /** Abstract Syntax Tree Rewriter
+     *
+     * Walks the whole syntax tree and passes every expression, statement and
+     * block through rewrite(), rewrite_statement() and rewrite_block(). The
+     * returned node is stored in place of the old one, which makes it
+     * possible to transform parts of the tree without knowing about the
+     * surrounding nodes. A statement can be removed by returning nullptr
+     * from rewrite_statement().
+     *
+     * The rewriter keeps track of the symbol tables of the scopes (and
+     * lambdas) that are entered, and of the statement that is currently being
+     * visited, so that new statements can be inserted before it.
+     *
+     * @details The root block should be rewritten with rewrite_block() (and
+     * not accept()), since the first statement of the block may be removed.
+     */
+    class AST_Rewriter : public AST_Visitor
+    {
+        public:
+            AST_Rewriter(symbol::SymbolTable *t)
+                : tables_(1, t), cursor_(nullptr), prev_(nullptr) {}
+
+            virtual ~AST_Rewriter() {}
+
+            /** Rewrites an expression, returning the expression that should
+             * take its place. The default implementation rewrites the
+             * subexpressions and returns the expression itself */
+            virtual Expression *rewrite(Expression *e) {
+                e->accept(*this);
+                return e;
+            }
+
+            /** Rewrites a statement, returning the statement that should take
+             * its place (or nullptr to remove it) */
+            virtual Statement *rewrite_statement(Statement *s) {
+                s->accept(*this);
+                return s;
+            }
+
+            /** Rewrites the statements of a block, returning the new first
+             * statement (or nullptr if all statements were removed) */
+            virtual Statements *rewrite_block(Statements *);
+
+            virtual void visit(TernaryIf *);
+            virtual void visit(And *);
+            virtual void visit(Or *);
+            virtual void visit(Not *);
+            virtual void visit(BoolEquals *);
+            virtual void visit(LessThan *);
+            virtual void visit(LessThanOrEqual *);
+            virtual void visit(GreaterThan *);
+            virtual void visit(GreaterThanOrEqual *);
+            virtual void visit(Equals *);
+            virtual void visit(Plus *);
+            virtual void visit(Minus *);
+            virtual void visit(Times *);
+            virtual void visit(StringLessThan *);
+            virtual void visit(StringLessThanOrEqual *);
+            virtual void visit(StringGreaterThan *);
+            virtual void visit(StringGreaterThanOrEqual *);
+            virtual void visit(StringEquals *);
+            virtual void visit(StringRepeat *);
+            virtual void visit(StringConcat *);
+            virtual void visit(ListConcat *);
+            virtual void visit(Constant *);
+            virtual void visit(MethodCall *);
+            virtual void visit(SymbolRef *);
+            virtual void visit(FieldRef *);
+            virtual void visit(List *);
+            virtual void visit(Record *);
+            virtual void visit(Pipeline *);
+            virtual void visit(StringJoin *);
+            virtual void visit(Dict *);
+            virtual void visit(LambdaExpression *);
+            virtual void visit(FunctionCall *);
+            virtual void visit(FuncArgList *);
+            virtual void visit(FuncArgExpression *);
+            virtual void visit(FuncArgLambda *);
+            virtual void visit(Statements *);
+            virtual void visit(Conditional *);
+            virtual void visit(ForEach *);
+            virtual void visit(ForEachEnum *);
+            virtual void visit(If *);
+            virtual void visit(Elif *);
+            virtual void visit(Else *);
+            virtual void visit(Text *);
+            virtual void visit(InlinedExpression *);
+            virtual void visit(VariableList *);
+            virtual void visit(VariableDeclaration *);
+            virtual void visit(VariableAssignment *);
+            virtual void visit(Create *);
+            virtual void visit(Macro *);
+            virtual void visit(MacroCall *);
+            virtual void visit(Memo *);
+            virtual void visit(Break *);
+            virtual void visit(Continue *);
+        protected:
+            /** Returns the symbol table of the innermost scope */
+            symbol::SymbolTable *current_table() {
+                return tables_.back();
+            }
+
+            /** Returns true if the symbol is defined in any of the entered
+             * tables */
+            bool defined_in_tables(symbol::Symbol *) const;
+
+            /** Inserts a statement before the statement currently being
+             * visited. The inserted statement will not be visited */
+            void insert_before(Statement *);
+
+            void binary(BinaryExpression *);
+            void rewrite_list(ExpressionList *);
+
+            vector<symbol::SymbolTable *> tables_;
+        private:
+            AST_Rewriter(const AST_Rewriter &) = delete;
+            AST_Rewriter &operator=(const AST_Rewriter &) = delete;
+
+            Statements *cursor_;
+            Statements *prev_;
+    };
+}
+
+#endif
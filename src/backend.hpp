@@ -57,6 +57,11 @@ class BackendUntypedSymbolTable
             return str;
         }
 
+        /** Lets the symbol use the same string as another symbol */
+        void alias(symbol::Symbol *s, const string &str) {
+            map_[s] = str;
+        }
+
     private:
         StringCreator creator_;
         map<symbol::Symbol *, string> map_;
@@ -159,8 +159,59 @@ namespace bash_backend
     {
     }
 
+    void BashBody::visit(ast::Pipeline *)
+    {
+    }
+
+    void BashBody::visit(ast::Dict *)
+    {
+    }
+
+    void BashBody::visit(ast::StringJoin *p)
+    {
+        /* The constant parts are written into the printf format, which is
+         * single quoted */
+        string fmt;
+
+        for (auto e = p->parts(); e != nullptr; e = e->next) {
+            ast::Constant *c = e->expression->constant();
+
+            if (!c) {
+                fmt += "%s";
+                continue;
+            }
+
+            auto s = static_cast<const StringConstantData *>(c->data());
+            for (char ch : s->value()) {
+                if (ch == '%')
+                    fmt += "%%";
+                else if (ch == '\\')
+                    fmt += "\\\\";
+                else if (ch == '\'')
+                    fmt += "'\\''";
+                else
+                    fmt += ch;
+            }
+        }
+
+        unindent() << "\"$(printf '" << fmt << "'";
+        for (auto e = p->parts(); e != nullptr; e = e->next) {
+            if (!e->expression->constant()) {
+                unindent() << " \"";
+                e->expression->accept(*this);
+                unindent() << "\"";
+            }
+        }
+        unindent() << ")\"";
+    }
+
     void BashBody::visit(ast::Conditional *p)
     {
+        if (p->dispatch_subject()) {
+            dispatch(p);
+            return;
+        }
+
         p->if_node()->accept(*this);
         if (p->elif_nodes())
             p->elif_nodes()->accept(*this);
@@ -169,6 +220,56 @@ namespace bash_backend
         indent() << "fi\n";
     }
 
+    /** Returns the constant as a single quoted case pattern */
+    static string pattern(ast::Constant *c)
+    {
+        stringstream ss;
+        string r = "'";
+
+        if (c->type() == TypeFactory::get("string"))
+            ss << static_cast<const StringConstantData *>(c->data())->value();
+        else
+            c->data()->print(ss);
+
+        for (char ch : ss.str()) {
+            if (ch == '\'')
+                r += "'\\''";
+            else
+                r += ch;
+        }
+        return r + "'";
+    }
+
+    void BashBody::dispatch(ast::Conditional *p)
+    {
+        vector<ast::Scope *> branches(1, p->if_node());
+
+        for (auto e = p->elif_nodes(); e != nullptr; e = e->next())
+            branches.push_back(e);
+
+        indent() << "case \"";
+        p->dispatch_subject()->accept(*this);
+        unindent() << "\" in\n";
+        indent_inc();
+        for (size_t i = 0; i < branches.size(); i++) {
+            indent() << pattern(p->dispatch_keys()[i]) << ")\n";
+            indent_inc();
+            if (branches[i]->statements())
+                branches[i]->statements()->accept(*this);
+            indent() << ";;\n";
+            indent_dec();
+        }
+        if (p->else_node() && p->else_node()->statements()) {
+            indent() << "*)\n";
+            indent_inc();
+            p->else_node()->statements()->accept(*this);
+            indent() << ";;\n";
+            indent_dec();
+        }
+        indent_dec();
+        indent() << "esac\n";
+    }
+
     void BashBody::visit(ast::ForEach *p)
     {
         /* for [variable] in [expression] ; do */
@@ -267,6 +368,26 @@ namespace bash_backend
     {
     }
 
+    void BashBody::visit(ast::Macro *)
+    {
+    }
+
+    void BashBody::visit(ast::MacroCall *)
+    {
+    }
+
+    void BashBody::visit(ast::Memo *)
+    {
+    }
+
+    void BashBody::visit(ast::Break *)
+    {
+    }
+
+    void BashBody::visit(ast::Continue *)
+    {
+    }
+
     void BashBody::binary(const string &, ast::BinaryExpression *)
     {
     }
@@ -84,6 +84,9 @@ namespace bash_backend {
             virtual void visit(ast::FieldRef *);
             virtual void visit(ast::List *);
             virtual void visit(ast::Record *);
+            virtual void visit(ast::Pipeline *);
+            virtual void visit(ast::StringJoin *);
+            virtual void visit(ast::Dict *);
             virtual void visit(ast::Statements *);
             virtual void visit(ast::Conditional *);
             virtual void visit(ast::ForEach *);
@@ -97,8 +100,14 @@ namespace bash_backend {
             virtual void visit(ast::VariableAssignment *);
             virtual void visit(ast::VariableDeclaration *);
             virtual void visit(ast::Create*);
+            virtual void visit(ast::Macro *);
+            virtual void visit(ast::MacroCall *);
+            virtual void visit(ast::Memo *);
+            virtual void visit(ast::Break *);
+            virtual void visit(ast::Continue *);
         private:
             void binary(const string &s, ast::BinaryExpression *e);
+            void dispatch(ast::Conditional *);
 
             BashSymbolTable table_;
     };
@@ -0,0 +1,34 @@
+#include <algorithm>
+
+#include "binding.hpp"
+
+namespace optimizer {
+
+    Expression *ArgumentBinding::rewrite(Expression *e)
+    {
+        SymbolRef *r = e->symbol_ref();
+
+        if (r && r->symbol()->argument()) {
+            auto it = bindings_.find(r->symbol()->argument());
+            if (it != bindings_.end())
+                return new Constant(copy_constant(it->second));
+        }
+        return AST_Rewriter::rewrite(e);
+    }
+
+    void bind_arguments(ParseData *data,
+                        const map<symbol::Argument *, ConstantData *> &b)
+    {
+        auto &args = data->arguments;
+
+        args.erase(remove_if(args.begin(), args.end(),
+                             [&](symbol::Argument *a) {
+                                 return b.count(a) != 0;
+                             }), args.end());
+
+        if (data->body) {
+            ArgumentBinding binding(data->root_table, b);
+            data->body = binding.rewrite_block(data->body);
+        }
+    }
+}
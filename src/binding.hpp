@@ -0,0 +1,37 @@
+#ifndef __BINDING_H__
+#define __BINDING_H__
+
+#include <map>
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** ArgumentBinding class
+     *
+     * Replaces the references to arguments that are bound at compile time
+     * (with -D) by the bound constants.
+     */
+    class ArgumentBinding : public AST_Rewriter
+    {
+        public:
+            ArgumentBinding(symbol::SymbolTable *t,
+                            const map<symbol::Argument *, ConstantData *> &b)
+                : AST_Rewriter(t), bindings_(b) {}
+
+            virtual Expression *rewrite(Expression *);
+        private:
+            ArgumentBinding(const ArgumentBinding &) = delete;
+            ArgumentBinding &operator=(const ArgumentBinding &) = delete;
+
+            const map<symbol::Argument *, ConstantData *> &bindings_;
+    };
+
+    /** Binds arguments of a parsed file to constants. The bound arguments
+     * are removed from the file's arguments, so that they are no longer
+     * parsed by the generated script */
+    void bind_arguments(ParseData *,
+                        const map<symbol::Argument *, ConstantData *> &);
+}
+
+#endif
@@ -53,7 +53,7 @@ class AsciiStringCreator
         string next() {
             bool append = true;
 
-            for (auto i = str_.length() - 1; i >= prefix_.length(); i--) {
+            for (auto i = str_.length(); i-- > prefix_.length(); ) {
                 if (str_[i] == 'z') {
                     str_[i] = 'a';
                 } else {
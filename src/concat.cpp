@@ -0,0 +1,102 @@
+#include "concat.hpp"
+
+namespace optimizer {
+
+    /* Repetitions that would give longer strings are left to the script */
+    static const size_t max_folded = 1024;
+
+    static const StringConstantData *string_constant(Expression *e)
+    {
+        Constant *c = e->constant();
+
+        if (c && c->type() == TypeFactory::get("string"))
+            return static_cast<const StringConstantData *>(c->data());
+        return nullptr;
+    }
+
+    /** Returns the repetition as a constant string, or nullptr if it isn't
+     * a (small) repetition of a constant */
+    static Constant *fold_repeat(StringRepeat *r)
+    {
+        Constant *c = r->rhs()->constant();
+
+        if (!string_constant(r->lhs()) || !c ||
+                c->type() != TypeFactory::get("int"))
+            return nullptr;
+
+        string s = string_constant(r->lhs())->value();
+        int n = static_cast<const IntConstantData *>(c->data())->value();
+        string out;
+
+        if (n > 0 && s.size() * n > max_folded)
+            return nullptr;
+        for (int i = 0; i < n; i++)
+            out += s;
+        return new Constant(new StringConstantData(out));
+    }
+
+    Expression *ConcatFlattening::rewrite(Expression *e)
+    {
+        if (!e->string_concat())
+            return AST_Rewriter::rewrite(e);
+
+        vector<Expression *> leaves;
+        vector<Expression *> parts;
+        flatten(e, leaves);
+
+        /* Merge the adjacent constants, and drop the empty ones */
+        for (auto l : leaves) {
+            auto s = string_constant(l);
+
+            if (s && s->value().empty())
+                continue;
+            if (s && !parts.empty() && string_constant(parts.back())) {
+                string v = string_constant(parts.back())->value();
+                parts.back() = new Constant(
+                    new StringConstantData(v + s->value()));
+            } else {
+                parts.push_back(l);
+            }
+        }
+
+        if (parts.empty())
+            return new Constant(new StringConstantData(""));
+        if (parts.size() < 3) {
+            Expression *r = parts[0];
+
+            for (size_t i = 1; i < parts.size(); i++)
+                r = new StringConcat(r, parts[i]);
+            return r;
+        }
+
+        ExpressionList *list = nullptr;
+        for (auto it = parts.rbegin(); it != parts.rend(); ++it)
+            list = new ExpressionList(*it, list);
+        return new StringJoin(list);
+    }
+
+    void ConcatFlattening::flatten(Expression *e, vector<Expression *> &leaves)
+    {
+        StringConcat *c = e->string_concat();
+
+        if (c) {
+            flatten(c->lhs(), leaves);
+            flatten(c->rhs(), leaves);
+            return;
+        }
+
+        e = rewrite(e);
+        if (e->string_join()) {
+            for (auto p = e->string_join()->parts(); p != nullptr; p = p->next)
+                leaves.push_back(p->expression);
+            return;
+        }
+
+        if (e->string_repeat()) {
+            Constant *f = fold_repeat(e->string_repeat());
+            if (f)
+                e = f;
+        }
+        leaves.push_back(e);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef __CONCAT_H__
+#define __CONCAT_H__
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** ConcatFlattening class
+     *
+     * Replaces chains of string concatenations with a single StringJoin
+     * node, so that the backends don't create every intermediate string:
+     *
+     *   ~~~
+     *   {{ name + " <" + mail + "> " + "-" * 2 }}
+     *   ~~~
+     *
+     * becomes a join of `name`, `" <"`, `mail` and `"> --"`.
+     *
+     * @details Repetitions of constant strings are folded, and adjacent
+     * constant parts are merged. Chains that end up with less than three
+     * parts are left as (or turned back into) plain concatenations.
+     */
+    class ConcatFlattening : public AST_Rewriter
+    {
+        public:
+            ConcatFlattening(symbol::SymbolTable *t)
+                : AST_Rewriter(t) {}
+
+            virtual Expression *rewrite(Expression *);
+        private:
+            void flatten(Expression *, vector<Expression *> &);
+    };
+}
+
+#endif
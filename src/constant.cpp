@@ -24,6 +24,93 @@ namespace constant {
         os << "]";
     }
 
+    DictConstantData::~DictConstantData()
+    {
+        for (auto &e : data_) {
+            delete e.first;
+            delete e.second;
+        }
+    }
+
+    void DictConstantData::add(PrimitiveConstantData *k,
+                               SingleConstantData *v)
+    {
+        if (k->type() != type()->key())
+            throw DifferentTypesError(k->type(), type()->key());
+        if (v->type() != type()->value())
+            throw DifferentTypesError(v->type(), type()->value());
+
+        /* Primitives of the same type are equal if they print the same */
+        stringstream ks;
+        k->print(ks);
+
+        for (auto &e : data_) {
+            stringstream es;
+            e.first->print(es);
+
+            if (es.str() == ks.str()) {
+                delete e.first;
+                delete e.second;
+                e = make_pair(k, v);
+                return;
+            }
+        }
+        data_.push_back(make_pair(k, v));
+    }
+
+    void DictConstantData::print(ostream &os) const
+    {
+        os << "{";
+
+        auto it = data_.begin();
+
+        while (it != data_.end()) {
+            it->first->print(os);
+            os << ": ";
+            it->second->print(os);
+            if (++it != data_.end())
+                os << ", ";
+        }
+
+        os << "}";
+    }
+
+    void SetConstantData::add(PrimitiveConstantData *d)
+    {
+        if (d->type() != type()->elem())
+            throw DifferentTypesError(d->type(), type()->elem());
+
+        /* Primitives of the same type are equal if they print the same */
+        stringstream ds;
+        d->print(ds);
+
+        for (auto e : data_) {
+            stringstream es;
+            e->print(es);
+
+            if (es.str() == ds.str()) {
+                delete d;
+                return;
+            }
+        }
+        data_.push_back(d);
+    }
+
+    void SetConstantData::print(ostream &os) const
+    {
+        os << "{";
+
+        auto it = data_.begin();
+
+        while (it != data_.end()) {
+            (*it)->print(os);
+            if (++it != data_.end())
+                os << ", ";
+        }
+
+        os << "}";
+    }
+
     void RecordConstantData::print(ostream &os) const
     {
         os << "{";
@@ -54,7 +141,7 @@ namespace constant {
         os << "\"" << Escaper()(value_) << "\"";
     }
 
-    void RecordConstantData::set(const vector<PrimitiveConstantData *> &v)
+    void RecordConstantData::set(const vector<ConstantData *> &v)
     {
         if (v.size() != values_.size()) {
             stringstream s;
@@ -64,8 +151,8 @@ namespace constant {
         }
 
         auto m = mismatch(values_.begin(), values_.end(), v.begin(),
-                          [] (const PrimitiveConstantData *c,
-        const PrimitiveConstantData *n) {
+                          [] (const ConstantData *c,
+        const ConstantData *n) {
             return c->type() == n->type();
         });
 
@@ -83,10 +170,8 @@ namespace constant {
 
     void RecordConstantData::set_default()
     {
-        for (auto it = type_->begin(); it != type_->end(); ++it) {
-            RecordField f = (*it);
-            values_.push_back(create_primitive_constant(f.type));
-        }
+        for (auto it = type_->begin(); it != type_->end(); ++it)
+            values_.push_back(create_default_constant((*it).type));
     }
 
     void RecordConstantData::clear()
@@ -95,6 +180,75 @@ namespace constant {
             delete (*it);
     }
 
+    /** Creates deep copies of constants */
+    class ConstantCopier : public ConstantDataVisitor
+    {
+        public:
+            ConstantCopier()
+                : copy(nullptr) {}
+
+            virtual void visit(const BoolConstantData *p) {
+                copy = new BoolConstantData(p->value());
+            }
+
+            virtual void visit(const IntConstantData *p) {
+                copy = new IntConstantData(p->value());
+            }
+
+            virtual void visit(const StringConstantData *p) {
+                copy = new StringConstantData(p->value());
+            }
+
+            virtual void visit(const ListConstantData *p) {
+                ListConstantData *l = new ListConstantData(p->type());
+
+                for (auto it = p->begin(); it != p->end(); ++it) {
+                    (*it)->accept(*this);
+                    l->add(static_cast<SingleConstantData *>(copy));
+                }
+                copy = l;
+            }
+
+            virtual void visit(const RecordConstantData *p) {
+                RecordConstantData *r = new RecordConstantData(p->type());
+                vector<ConstantData *> values;
+
+                for (auto it = p->begin(); it != p->end(); ++it) {
+                    (*it)->accept(*this);
+                    values.push_back(copy);
+                }
+                r->set(values);
+                copy = r;
+            }
+
+            virtual void visit(const DictConstantData *p) {
+                DictConstantData *d = new DictConstantData(p->type());
+
+                for (auto it = p->begin(); it != p->end(); ++it) {
+                    it->first->accept(*this);
+                    auto k = static_cast<PrimitiveConstantData *>(copy);
+                    it->second->accept(*this);
+                    d->add(k, static_cast<SingleConstantData *>(copy));
+                }
+                copy = d;
+            }
+
+            virtual void visit(const SetConstantData *p) {
+                SetConstantData *s = new SetConstantData(p->type());
+
+                for (auto it = p->begin(); it != p->end(); ++it) {
+                    (*it)->accept(*this);
+                    s->add(static_cast<PrimitiveConstantData *>(copy));
+                }
+                copy = s;
+            }
+
+            ConstantData *copy;
+        private:
+            ConstantCopier(const ConstantCopier &) = delete;
+            ConstantCopier &operator=(const ConstantCopier &) = delete;
+    };
+
     PrimitiveConstantData *create_primitive_constant(const PrimitiveType *t)
     {
         if (t == TypeFactory::get("bool"))
@@ -115,8 +269,19 @@ namespace constant {
             return new ListConstantData(t->list());
         else if (t->record())
             return new RecordConstantData(t->record());
+        else if (t->dict())
+            return new DictConstantData(t->dict());
+        else if (t->set())
+            return new SetConstantData(t->set());
         else
             return nullptr;
     }
 
+    ConstantData *copy_constant(const ConstantData *d)
+    {
+        ConstantCopier c;
+        d->accept(c);
+        return c.copy;
+    }
+
 }
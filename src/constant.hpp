@@ -22,6 +22,8 @@ namespace constant {
     class StringConstantData;
     class ListConstantData;
     class RecordConstantData;
+    class DictConstantData;
+    class SetConstantData;
 
     class ConstantData
     {
@@ -62,11 +64,16 @@ namespace constant {
             virtual void visit(const StringConstantData *) = 0;
             virtual void visit(const ListConstantData *) = 0;
             virtual void visit(const RecordConstantData *) = 0;
+            virtual void visit(const DictConstantData *) = 0;
+            virtual void visit(const SetConstantData *) = 0;
     };
 
     PrimitiveConstantData *create_primitive_constant(const PrimitiveType *);
     ConstantData *create_default_constant(const Type *t);
 
+    /** Returns a deep copy of the constant */
+    ConstantData *copy_constant(const ConstantData *);
+
     class SingleConstantData : public ConstantData
     {
         public:
@@ -223,8 +230,7 @@ namespace constant {
                 clear();
             }
 
-            typedef vector<PrimitiveConstantData *>::const_iterator
-            iterator;
+            typedef vector<ConstantData *>::const_iterator iterator;
 
             virtual const RecordType *type() const {
                 return type_;
@@ -236,8 +242,10 @@ namespace constant {
 
             /** Set the fields. The object will take over ownership of the
              * constants
+             *
+             * @throw UnmatchingFieldSignature
              */
-            void set(const vector<PrimitiveConstantData *> &);
+            void set(const vector<ConstantData *> &);
 
             iterator begin() const {
                 return values_.begin();
@@ -253,7 +261,88 @@ namespace constant {
             void set_default();
 
             const RecordType *type_;
-            vector<PrimitiveConstantData *> values_;
+            vector<ConstantData *> values_;
+    };
+
+    class DictConstantData : public ConstantData
+    {
+        public:
+            DictConstantData(const DictType *t) : type_(t), data_() {}
+
+            ~DictConstantData();
+
+            typedef pair<PrimitiveConstantData *, SingleConstantData *>
+            entry;
+            typedef vector<entry>::const_iterator iterator;
+
+            virtual const DictType *type() const {
+                return type_;
+            }
+            virtual void print(ostream &) const;
+            virtual void accept(ConstantDataVisitor &v) const {
+                v.visit(this);
+            }
+
+            /** Add an entry to the dictionary, replacing the value of an
+             * equal key. Throws if wrong type
+             *
+             * @throw DifferentTypesError
+             */
+            void add(PrimitiveConstantData *k, SingleConstantData *v);
+
+            iterator begin() const {
+                return data_.begin();
+            }
+            iterator end() const {
+                return data_.end();
+            }
+        private:
+            DictConstantData(const DictConstantData &) = delete;
+            DictConstantData &operator=(const DictConstantData &) = delete;
+
+            const DictType *type_;
+            vector<entry> data_;
+    };
+
+    class SetConstantData : public ConstantData
+    {
+        public:
+            SetConstantData(const SetType *t) : type_(t), data_() {}
+
+            ~SetConstantData() {
+                for (auto d : data_)
+                    delete d;
+            }
+
+            typedef vector<PrimitiveConstantData *>::const_iterator iterator;
+
+            virtual const SetType *type() const {
+                return type_;
+            }
+            virtual void print(ostream &) const;
+            virtual void accept(ConstantDataVisitor &v) const {
+                v.visit(this);
+            }
+
+            /** Add an element to the set. An element that is already in the
+             * set is deleted. Throws if wrong type
+             *
+             * @throw DifferentTypesError
+             */
+            void add(PrimitiveConstantData *);
+
+            iterator begin() const {
+                return data_.begin();
+            }
+            iterator end() const {
+                return data_.end();
+            }
+        private:
+            SetConstantData(const SetConstantData &) = delete;
+            SetConstantData &operator=(const SetConstantData &) = delete;
+
+            const SetType *type_;
+            vector<PrimitiveConstantData *> data_;
     };
 
 }
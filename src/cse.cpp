@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <sstream>
+
+#include "cse.hpp"
+
+namespace optimizer {
+
+    Expression *CommonSubexpressionElimination::rewrite(Expression *e)
+    {
+        if (mode_ == COLLECT) {
+            size_t i = block_->occurrences.size();
+
+            block_->occurrences.push_back(Occurrence());
+            AST_Rewriter::rewrite(e);
+
+            Occurrence &o = block_->occurrences[i];
+            o.end = block_->occurrences.size();
+            o.candidate = candidate(e);
+            o.live = true;
+            if (o.candidate)
+                o.group = group(e);
+        } else if (mode_ == REPLACE) {
+            Occurrence &o = block_->occurrences[block_->next++];
+
+            if (o.candidate && block_->chosen.count(o.group)) {
+                auto it = block_->temps.find(o.group);
+
+                if (it != block_->temps.end()) {
+                    block_->next = o.end;
+                    return new SymbolRef(it->second);
+                }
+
+                /* First occurrence, becomes the temporary's value */
+                string g = o.group;
+                AST_Rewriter::rewrite(e);
+
+                auto v = create_temporary(current_table(), e->type(), "cse");
+                block_->temps[g] = v;
+                insert_before(new VariableList(new VariableDeclaration(v, e),
+                                               nullptr));
+                return new SymbolRef(v);
+            }
+            return AST_Rewriter::rewrite(e);
+        }
+
+        return e;
+    }
+
+    void CommonSubexpressionElimination::visit(LambdaExpression *p)
+    {
+        lambdas_.push_back(p->table);
+        AST_Rewriter::visit(p);
+        lambdas_.pop_back();
+    }
+
+    Statements *CommonSubexpressionElimination::rewrite_block(Statements *p)
+    {
+        Block block;
+        Block *saved_block = block_;
+        Mode saved_mode = mode_;
+
+        block_ = &block;
+
+        mode_ = COLLECT;
+        AST_Rewriter::rewrite_block(p);
+
+        decide();
+
+        if (!block.chosen.empty()) {
+            mode_ = REPLACE;
+            p = AST_Rewriter::rewrite_block(p);
+        }
+
+        mode_ = DESCEND;
+        p = AST_Rewriter::rewrite_block(p);
+
+        block_ = saved_block;
+        mode_ = saved_mode;
+        return p;
+    }
+
+    void CommonSubexpressionElimination::visit(ForEach *p)
+    {
+        if (mode_ == DESCEND) {
+            AST_Rewriter::visit(p);
+        } else {
+            p->set_expression(rewrite(p->expression()));
+            assigned(p->statements());
+        }
+    }
+
+    void CommonSubexpressionElimination::visit(ForEachEnum *p)
+    {
+        if (mode_ == DESCEND) {
+            AST_Rewriter::visit(p);
+        } else {
+            p->set_expression(rewrite(p->expression()));
+            assigned(p->statements());
+        }
+    }
+
+    void CommonSubexpressionElimination::visit(If *p)
+    {
+        if (mode_ == DESCEND) {
+            AST_Rewriter::visit(p);
+        } else {
+            p->set_condition(rewrite(p->condition()));
+            assigned(p->statements());
+        }
+    }
+
+    void CommonSubexpressionElimination::visit(Elif *p)
+    {
+        /* The conditions of the elifs are not always evaluated, leave them
+         * to the DESCEND walk */
+        if (mode_ == DESCEND) {
+            AST_Rewriter::visit(p);
+        } else {
+            assigned(p->statements());
+            if (p->next())
+                p->next()->accept(*this);
+        }
+    }
+
+    void CommonSubexpressionElimination::visit(Else *p)
+    {
+        if (mode_ == DESCEND)
+            AST_Rewriter::visit(p);
+        else
+            assigned(p->statements());
+    }
+
+    void CommonSubexpressionElimination::visit(Macro *p)
+    {
+        /* The body is a block of its own, that isn't evaluated where the
+         * macro is defined */
+        if (mode_ == DESCEND)
+            AST_Rewriter::visit(p);
+    }
+
+    void CommonSubexpressionElimination::visit(Memo *p)
+    {
+        if (mode_ == DESCEND) {
+            AST_Rewriter::visit(p);
+        } else {
+            p->set_key(rewrite(p->key()));
+            assigned(p->statements());
+        }
+    }
+
+    void CommonSubexpressionElimination::visit(VariableList *p)
+    {
+        AST_Rewriter::visit(p);
+        if (mode_ == COLLECT)
+            block_->list_assigned.clear();
+    }
+
+    void CommonSubexpressionElimination::visit(VariableAssignment *p)
+    {
+        AST_Rewriter::visit(p);
+        if (mode_ == COLLECT) {
+            block_->versions[p->variable()]++;
+            block_->list_assigned.insert(p->variable());
+        }
+    }
+
+    bool CommonSubexpressionElimination::candidate(Expression *e)
+    {
+        if (!(e->method_call() || e->function_call() || e->pipeline() ||
+              e->string_concat() || e->list_concat() ||
+              (e->field_ref() && !is_trivial(e))))
+            return false;
+
+        /* The temporary is evaluated before the statement, so it can't
+         * depend on variables assigned earlier in the same with-statement
+         * or on variables bound by a surrounding lambda */
+        for (auto s : free_symbols(e)) {
+            if (block_->list_assigned.count(s))
+                return false;
+            for (auto t : lambdas_) {
+                if (t->contains(s))
+                    return false;
+            }
+        }
+
+        return is_speculatable(e);
+    }
+
+    string CommonSubexpressionElimination::group(Expression *e)
+    {
+        stringstream ss;
+
+        ss << structural_key(e);
+        for (auto s : free_symbols(e))
+            ss << "@" << s << ":" << block_->versions[s];
+        return ss.str();
+    }
+
+    void CommonSubexpressionElimination::assigned(Statements *s)
+    {
+        for (auto v : assigned_variables(s))
+            block_->versions[v]++;
+    }
+
+    void CommonSubexpressionElimination::decide()
+    {
+        auto &occ = block_->occurrences;
+        map<string, vector<size_t> > groups;
+        vector<pair<size_t, string> > order;
+
+        for (size_t i = 0; i < occ.size(); i++) {
+            if (occ[i].candidate) {
+                auto &g = groups[occ[i].group];
+                if (g.empty())
+                    order.push_back(make_pair(occ[i].end - i, occ[i].group));
+                g.push_back(i);
+            }
+        }
+
+        /* Handle the largest expressions first, since the repetitions
+         * inside a replaced occurrence disappear along with it */
+        stable_sort(order.begin(), order.end(),
+                    [](const pair<size_t, string> &a,
+                       const pair<size_t, string> &b) {
+                        return a.first > b.first;
+                    });
+
+        for (auto &o : order) {
+            vector<size_t> live;
+
+            for (auto i : groups[o.second]) {
+                if (occ[i].live)
+                    live.push_back(i);
+            }
+
+            if (live.size() < 2)
+                continue;
+
+            block_->chosen.insert(o.second);
+            for (size_t k = 1; k < live.size(); k++) {
+                for (size_t j = live[k] + 1; j < occ[live[k]].end; j++)
+                    occ[j].live = false;
+            }
+        }
+    }
+}
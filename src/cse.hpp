@@ -0,0 +1,105 @@
+#ifndef __CSE_H__
+#define __CSE_H__
+
+#include <map>
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** CommonSubexpressionElimination class
+     *
+     * Finds method calls, function calls, field references and
+     * concatenations that are repeated in the statements of a block, and
+     * evaluates them once:
+     *
+     *   ~~~
+     *   #ifndef {{ f.name.upper() }}_H
+     *   #define {{ f.name.upper() }}_H
+     *   ~~~
+     *
+     * is rewritten to
+     *
+     *   ~~~
+     *   % with string __cse0 = f.name.upper()
+     *   #ifndef {{ __cse0 }}_H
+     *   #define {{ __cse0 }}_H
+     *   ~~~
+     *
+     * @details Only expressions evaluated by the block itself are considered
+     * (i.e. not the ones in nested blocks, which are handled as blocks of
+     * their own). Two expressions are only considered the same if none of
+     * the variables they depend on are assigned between them.
+     */
+    class CommonSubexpressionElimination : public AST_Rewriter
+    {
+        public:
+            CommonSubexpressionElimination(symbol::SymbolTable *t)
+                : AST_Rewriter(t), mode_(DESCEND), block_(nullptr),
+                  lambdas_() {}
+
+            virtual Expression *rewrite(Expression *);
+            virtual Statements *rewrite_block(Statements *);
+
+            using AST_Rewriter::visit;
+            virtual void visit(LambdaExpression *);
+            virtual void visit(ForEach *);
+            virtual void visit(ForEachEnum *);
+            virtual void visit(If *);
+            virtual void visit(Elif *);
+            virtual void visit(Else *);
+            virtual void visit(Macro *);
+            virtual void visit(Memo *);
+            virtual void visit(VariableList *);
+            virtual void visit(VariableAssignment *);
+        private:
+            CommonSubexpressionElimination(
+                const CommonSubexpressionElimination &) = delete;
+            CommonSubexpressionElimination &operator=(
+                const CommonSubexpressionElimination &) = delete;
+
+            enum Mode {
+                COLLECT,   /* Find the expressions of the block */
+                REPLACE,   /* Replace the repeated expressions */
+                DESCEND    /* Visit the nested blocks */
+            };
+
+            struct Occurrence
+            {
+                Occurrence()
+                    : group(), end(0), candidate(false), live(true) {}
+
+                string group;
+                size_t end;
+                bool candidate;
+                bool live;
+            };
+
+            struct Block
+            {
+                Block()
+                    : occurrences(), chosen(), temps(), versions(),
+                      list_assigned(), next(0) {}
+
+                /* All expressions of the block, in pre-order. The
+                 * subexpressions of occurrence i are [i + 1, end) */
+                vector<Occurrence> occurrences;
+                set<string> chosen;
+                map<string, symbol::Variable *> temps;
+                map<symbol::Symbol *, unsigned> versions;
+                set<symbol::Symbol *> list_assigned;
+                size_t next;
+            };
+
+            bool candidate(Expression *);
+            string group(Expression *);
+            void assigned(Statements *);
+            void decide();
+
+            Mode mode_;
+            Block *block_;
+            vector<symbol::SymbolTable *> lambdas_;
+    };
+}
+
+#endif
@@ -10,13 +10,21 @@ struct ParseData
         ParseData()
             : root_table(new symbol::SymbolTable),
               current_table(root_table),
-              arguments(), body(nullptr) {}
+              arguments(), body(nullptr), macros(), loop_depths(1, 0) {}
 
         symbol::SymbolTable *root_table;
         symbol::SymbolTable *current_table;
         vector<symbol::Argument *> arguments;
         ast::Statements *body;
 
+        /* The macros that have been defined in the body, by name */
+        map<string, ast::Macro *> macros;
+
+        /* The number of loops that the statements being parsed are in. A
+         * memo block pushes a new count, since break and continue can't
+         * leave it */
+        vector<unsigned> loop_depths;
+
     private:
         ParseData(const ParseData &) = delete;
         ParseData &operator=(const ParseData &) = delete;
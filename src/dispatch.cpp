@@ -0,0 +1,73 @@
+#include <sstream>
+
+#include "dispatch.hpp"
+
+namespace optimizer {
+
+    static const size_t min_keys = 4;
+
+    /** Splits a comparison with a constant into the compared expression and
+     * the constant. Returns false if the condition isn't such a
+     * comparison */
+    static bool comparison(Expression *e, Expression *&subject,
+                           Constant *&key)
+    {
+        BinaryExpression *b = e->string_equals();
+
+        if (!b)
+            b = e->equals();
+        if (!b)
+            return false;
+
+        if (b->rhs()->constant() && !b->lhs()->constant()) {
+            subject = b->lhs();
+            key = b->rhs()->constant();
+        } else if (b->lhs()->constant() && !b->rhs()->constant()) {
+            subject = b->rhs();
+            key = b->lhs()->constant();
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    void TableDispatch::visit(Conditional *p)
+    {
+        AST_Rewriter::visit(p);
+
+        vector<Expression *> conditions(1, p->if_node()->condition());
+        for (auto e = p->elif_nodes(); e != nullptr; e = e->next())
+            conditions.push_back(e->condition());
+
+        if (conditions.size() < min_keys)
+            return;
+
+        Expression *subject = nullptr;
+        vector<Constant *> keys;
+        string subject_key;
+        set<string> seen;
+
+        for (auto c : conditions) {
+            Expression *s;
+            Constant *k;
+            stringstream ss;
+
+            if (!comparison(c, s, k))
+                return;
+
+            if (!subject) {
+                subject = s;
+                subject_key = structural_key(s);
+            } else if (structural_key(s) != subject_key) {
+                return;
+            }
+
+            k->data()->print(ss);
+            if (!seen.insert(ss.str()).second)
+                return;
+            keys.push_back(k);
+        }
+
+        p->set_dispatch(subject, keys);
+    }
+}
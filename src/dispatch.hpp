@@ -0,0 +1,41 @@
+#ifndef __DISPATCH_H__
+#define __DISPATCH_H__
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** TableDispatch class
+     *
+     * Finds if/elif chains where every condition compares the same
+     * expression with a distinct constant:
+     *
+     *   ~~~
+     *   % if kind == "c"
+     *   ...
+     *   % elif kind == "cpp"
+     *   ...
+     *   % elif kind == "py"
+     *   ...
+     *   % endif
+     *   ~~~
+     *
+     * and marks them as dispatches (see Conditional::set_dispatch()), which
+     * lets the backends select the branch with a table lookup instead of
+     * testing the conditions one by one.
+     *
+     * @details Only chains with at least four comparisons are marked, since
+     * the lookup doesn't pay off for shorter chains.
+     */
+    class TableDispatch : public AST_Rewriter
+    {
+        public:
+            TableDispatch(symbol::SymbolTable *t)
+                : AST_Rewriter(t) {}
+
+            using AST_Rewriter::visit;
+            virtual void visit(Conditional *);
+    };
+}
+
+#endif
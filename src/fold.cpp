@@ -0,0 +1,379 @@
+#include <climits>
+
+#include "fold.hpp"
+
+namespace optimizer {
+
+    static const BoolConstantData *bool_constant(Expression *e)
+    {
+        Constant *c = e->constant();
+
+        if (c && c->type() == TypeFactory::get("bool"))
+            return static_cast<const BoolConstantData *>(c->data());
+        return nullptr;
+    }
+
+    static const IntConstantData *int_constant(Expression *e)
+    {
+        Constant *c = e->constant();
+
+        if (c && c->type() == TypeFactory::get("int"))
+            return static_cast<const IntConstantData *>(c->data());
+        return nullptr;
+    }
+
+    static const StringConstantData *string_constant(Expression *e)
+    {
+        Constant *c = e->constant();
+
+        if (c && c->type() == TypeFactory::get("string"))
+            return static_cast<const StringConstantData *>(c->data());
+        return nullptr;
+    }
+
+    Expression *ConstantFolding::rewrite(Expression *e)
+    {
+        Expression *r;
+
+        folded_ = nullptr;
+        e->accept(*this);
+        r = folded_;
+        folded_ = nullptr;
+
+        return r ? r : e;
+    }
+
+    Statement *ConstantFolding::rewrite_statement(Statement *s)
+    {
+        s = AST_Rewriter::rewrite_statement(s);
+
+        if (s->conditional())
+            return prune(s->conditional());
+        return s;
+    }
+
+    void ConstantFolding::visit(TernaryIf *p)
+    {
+        AST_Rewriter::visit(p);
+        if (auto c = bool_constant(p->condition()))
+            folded_ = c->value() ? p->if_true() : p->if_false();
+    }
+
+    void ConstantFolding::visit(And *p)
+    {
+        AST_Rewriter::visit(p);
+        if (auto l = bool_constant(p->lhs()))
+            folded_ = l->value() ? p->rhs() : p->lhs();
+        else if (auto r = bool_constant(p->rhs()))
+            folded_ = r->value() ? p->lhs() : nullptr;
+    }
+
+    void ConstantFolding::visit(Or *p)
+    {
+        AST_Rewriter::visit(p);
+        if (auto l = bool_constant(p->lhs()))
+            folded_ = l->value() ? p->lhs() : p->rhs();
+        else if (auto r = bool_constant(p->rhs()))
+            folded_ = r->value() ? nullptr : p->lhs();
+    }
+
+    void ConstantFolding::visit(Not *p)
+    {
+        AST_Rewriter::visit(p);
+        if (auto c = bool_constant(p->expression()))
+            folded_ = new Constant(new BoolConstantData(!c->value()));
+    }
+
+    void ConstantFolding::visit(BoolEquals *p)
+    {
+        AST_Rewriter::visit(p);
+
+        auto l = bool_constant(p->lhs());
+        auto r = bool_constant(p->rhs());
+
+        if (l && r) {
+            folded_ = new Constant(new BoolConstantData(
+                l->value() == r->value()));
+        }
+    }
+
+    void ConstantFolding::visit(LessThan *p)
+    {
+        fold_int_compare(p, [](int a, int b) { return a < b; });
+    }
+
+    void ConstantFolding::visit(LessThanOrEqual *p)
+    {
+        fold_int_compare(p, [](int a, int b) { return a <= b; });
+    }
+
+    void ConstantFolding::visit(GreaterThan *p)
+    {
+        fold_int_compare(p, [](int a, int b) { return a > b; });
+    }
+
+    void ConstantFolding::visit(GreaterThanOrEqual *p)
+    {
+        fold_int_compare(p, [](int a, int b) { return a >= b; });
+    }
+
+    void ConstantFolding::visit(Equals *p)
+    {
+        fold_int_compare(p, [](int a, int b) { return a == b; });
+    }
+
+    void ConstantFolding::visit(Plus *p)
+    {
+        fold_int(p, [](long long a, long long b) { return a + b; });
+    }
+
+    void ConstantFolding::visit(Minus *p)
+    {
+        fold_int(p, [](long long a, long long b) { return a - b; });
+    }
+
+    void ConstantFolding::visit(Times *p)
+    {
+        fold_int(p, [](long long a, long long b) { return a * b; });
+    }
+
+    void ConstantFolding::visit(StringLessThan *p)
+    {
+        fold_string_compare(p, [](const string &a, const string &b) {
+            return a < b;
+        });
+    }
+
+    void ConstantFolding::visit(StringLessThanOrEqual *p)
+    {
+        fold_string_compare(p, [](const string &a, const string &b) {
+            return a <= b;
+        });
+    }
+
+    void ConstantFolding::visit(StringGreaterThan *p)
+    {
+        fold_string_compare(p, [](const string &a, const string &b) {
+            return a > b;
+        });
+    }
+
+    void ConstantFolding::visit(StringGreaterThanOrEqual *p)
+    {
+        fold_string_compare(p, [](const string &a, const string &b) {
+            return a >= b;
+        });
+    }
+
+    void ConstantFolding::visit(StringEquals *p)
+    {
+        fold_string_compare(p, [](const string &a, const string &b) {
+            return a == b;
+        });
+    }
+
+    void ConstantFolding::visit(StringRepeat *p)
+    {
+        AST_Rewriter::visit(p);
+
+        auto s = string_constant(p->lhs());
+        auto n = int_constant(p->rhs());
+
+        /* Large repetitions are left to the script, instead of bloating the
+         * generated code */
+        if (s && n && s->value().size() * max(n->value(), 0) <= 1024) {
+            string r;
+
+            for (int i = 0; i < n->value(); i++)
+                r += s->value();
+            folded_ = new Constant(new StringConstantData(r));
+        }
+    }
+
+    void ConstantFolding::visit(StringConcat *p)
+    {
+        AST_Rewriter::visit(p);
+
+        auto l = string_constant(p->lhs());
+        auto r = string_constant(p->rhs());
+
+        if (l && r) {
+            folded_ = new Constant(new StringConstantData(
+                l->value() + r->value()));
+        } else if (l && l->value().empty()) {
+            folded_ = p->rhs();
+        } else if (r && r->value().empty()) {
+            folded_ = p->lhs();
+        }
+    }
+
+    void ConstantFolding::visit(FieldRef *p)
+    {
+        AST_Rewriter::visit(p);
+
+        Constant *c = p->record()->constant();
+
+        if (c && c->type()->record()) {
+            auto d = static_cast<const RecordConstantData *>(c->data());
+            auto t = c->type()->record();
+            auto v = d->begin();
+
+            for (auto f = t->begin(); f != t->end(); ++f, ++v) {
+                if ((*f).name == p->field()) {
+                    folded_ = new Constant(copy_constant(*v));
+                    break;
+                }
+            }
+        }
+    }
+
+    void ConstantFolding::visit(List *p)
+    {
+        AST_Rewriter::visit(p);
+
+        for (auto e = p->elements(); e != nullptr; e = e->next) {
+            if (!e->expression->constant())
+                return;
+        }
+
+        ListConstantData *l = new ListConstantData(p->type());
+        for (auto e = p->elements(); e != nullptr; e = e->next) {
+            l->add(static_cast<SingleConstantData *>(
+                copy_constant(e->expression->constant()->data())));
+        }
+        folded_ = new Constant(l);
+    }
+
+    void ConstantFolding::visit(Record *p)
+    {
+        AST_Rewriter::visit(p);
+
+        vector<ConstantData *> values;
+
+        for (auto e = p->fields(); e != nullptr; e = e->next) {
+            if (!e->expression->constant()) {
+                for (auto v : values)
+                    delete v;
+                return;
+            }
+            values.push_back(copy_constant(e->expression->constant()->data()));
+        }
+
+        RecordConstantData *r = new RecordConstantData(p->type());
+        r->set(values);
+        folded_ = new Constant(r);
+    }
+
+    template<typename F>
+    void ConstantFolding::fold_int(BinaryExpression *p, F f)
+    {
+        binary(p);
+
+        auto l = int_constant(p->lhs());
+        auto r = int_constant(p->rhs());
+
+        if (l && r) {
+            long long v = f(l->value(), r->value());
+
+            if (v >= INT_MIN && v <= INT_MAX)
+                folded_ = new Constant(new IntConstantData(v));
+        }
+    }
+
+    template<typename F>
+    void ConstantFolding::fold_int_compare(BinaryExpression *p, F f)
+    {
+        binary(p);
+
+        auto l = int_constant(p->lhs());
+        auto r = int_constant(p->rhs());
+
+        if (l && r)
+            folded_ = new Constant(new BoolConstantData(f(l->value(),
+                                                          r->value())));
+    }
+
+    template<typename F>
+    void ConstantFolding::fold_string_compare(BinaryExpression *p, F f)
+    {
+        binary(p);
+
+        auto l = string_constant(p->lhs());
+        auto r = string_constant(p->rhs());
+
+        if (l && r)
+            folded_ = new Constant(new BoolConstantData(f(l->value(),
+                                                          r->value())));
+    }
+
+    Statement *ConstantFolding::prune(Conditional *p)
+    {
+        vector<Scope *> branches;
+        vector<Expression *> conditions;
+        bool otherwise = false;
+        bool changed = false;
+
+        /* Keep the branches that can be taken. A branch with a condition
+         * that is always true ends the chain */
+        auto keep = [&](Scope *s, Expression *c) {
+            auto b = c ? bool_constant(c) : nullptr;
+
+            if (otherwise || (b && !b->value())) {
+                changed = true;
+                return;
+            }
+            if (c == nullptr || b) {
+                changed = changed || b != nullptr;
+                otherwise = true;
+                c = nullptr;
+            }
+            branches.push_back(s);
+            conditions.push_back(c);
+        };
+
+        keep(p->if_node(), p->if_node()->condition());
+        for (Elif *e = p->elif_nodes(); e != nullptr; e = e->next())
+            keep(e, e->condition());
+        if (p->else_node())
+            keep(p->else_node(), nullptr);
+
+        if (branches.empty())
+            return nullptr;
+
+        if (conditions[0] == nullptr) {
+            /* Only one branch is left, which is always taken */
+            for (auto s = branches[0]->statements(); s != nullptr;
+                    s = s->next())
+                insert_before(s->statement());
+            return nullptr;
+        }
+
+        if (!changed)
+            return p;
+
+        If *i = new If(conditions[0], branches[0]->table());
+        i->set_statements(branches[0]->statements());
+        p->set_if_node(i);
+        p->set_elif_nodes(nullptr);
+        p->set_else_node(nullptr);
+
+        Elif *last = nullptr;
+        for (size_t k = 1; k < branches.size(); k++) {
+            if (conditions[k] == nullptr) {
+                Else *e = new Else(branches[k]->table());
+                e->set_statements(branches[k]->statements());
+                p->set_else_node(e);
+            } else {
+                Elif *e = new Elif(conditions[k], branches[k]->table());
+                e->set_statements(branches[k]->statements());
+                if (last)
+                    last->set_next(e);
+                else
+                    p->set_elif_nodes(e);
+                last = e;
+            }
+        }
+
+        return p;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef __FOLD_H__
+#define __FOLD_H__
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** ConstantFolding class
+     *
+     * Evaluates the operators whose operands are constants, and removes the
+     * branches of conditionals that can never be taken:
+     *
+     *   ~~~
+     *   % if makefile and not quiet
+     *   ...
+     *   % else
+     *   ...
+     *   % endif
+     *   ~~~
+     *
+     * is replaced by the statements of the else branch if `makefile` is bound
+     * to false with -D.
+     *
+     * @details Integer arithmetic is only folded if the result fits in an
+     * int, since the generated scripts may use a wider integer type.
+     */
+    class ConstantFolding : public AST_Rewriter
+    {
+        public:
+            ConstantFolding(symbol::SymbolTable *t)
+                : AST_Rewriter(t), folded_(nullptr) {}
+
+            virtual Expression *rewrite(Expression *);
+            virtual Statement *rewrite_statement(Statement *);
+
+            using AST_Rewriter::visit;
+            virtual void visit(TernaryIf *);
+            virtual void visit(And *);
+            virtual void visit(Or *);
+            virtual void visit(Not *);
+            virtual void visit(BoolEquals *);
+            virtual void visit(LessThan *);
+            virtual void visit(LessThanOrEqual *);
+            virtual void visit(GreaterThan *);
+            virtual void visit(GreaterThanOrEqual *);
+            virtual void visit(Equals *);
+            virtual void visit(Plus *);
+            virtual void visit(Minus *);
+            virtual void visit(Times *);
+            virtual void visit(StringLessThan *);
+            virtual void visit(StringLessThanOrEqual *);
+            virtual void visit(StringGreaterThan *);
+            virtual void visit(StringGreaterThanOrEqual *);
+            virtual void visit(StringEquals *);
+            virtual void visit(StringRepeat *);
+            virtual void visit(StringConcat *);
+            virtual void visit(FieldRef *);
+            virtual void visit(List *);
+            virtual void visit(Record *);
+        private:
+            ConstantFolding(const ConstantFolding &) = delete;
+            ConstantFolding &operator=(const ConstantFolding &) = delete;
+
+            template<typename F>
+            void fold_int(BinaryExpression *, F);
+            template<typename F>
+            void fold_int_compare(BinaryExpression *, F);
+            template<typename F>
+            void fold_string_compare(BinaryExpression *, F);
+
+            Statement *prune(Conditional *);
+
+            /* The replacement of the visited expression, if it was folded */
+            Expression *folded_;
+    };
+}
+
+#endif
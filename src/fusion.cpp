@@ -0,0 +1,57 @@
+#include "fusion.hpp"
+
+namespace optimizer {
+
+    Expression *PipelineFusion::rewrite(Expression *e)
+    {
+        FunctionCall *f;
+        MethodCall *m;
+
+        /* Fuse the innermost calls first */
+        e = AST_Rewriter::rewrite(e);
+
+        if ((f = e->function_call()) != nullptr &&
+                (f->name == "map" || f->name == "filter")) {
+            Expression *source = f->args->get_expression(1);
+            Pipeline *p = source->pipeline();
+
+            if (p == nullptr || !p->open())
+                p = new Pipeline(source);
+            p->add_stage(f->name == "map" ? Pipeline::MAP : Pipeline::FILTER,
+                         f->args->get_lambda(0), f->type());
+            return p;
+        } else if (f != nullptr && f->aggregation() &&
+                   f->args->get_expression(1)->pipeline() != nullptr &&
+                   f->args->get_expression(1)->pipeline()->open()) {
+            Pipeline *p = f->args->get_expression(1)->pipeline();
+            LambdaExpression *l = f->args->get_lambda(0);
+
+            /* count() is the size of the filtered list, and the other
+             * aggregations reduce the values of their lambda expression */
+            if (f->name == "count") {
+                p->add_stage(Pipeline::FILTER, l, p->type());
+                p->set_reduce("size", nullptr, f->type());
+            } else {
+                p->add_stage(Pipeline::MAP, l, TypeFactory::get_list(
+                                 l->expression->type()->single()));
+                p->set_reduce(f->name, nullptr, f->type());
+            }
+            return p;
+        } else if ((m = e->method_call()) != nullptr &&
+                   m->expression()->pipeline() != nullptr) {
+            Pipeline *p = m->expression()->pipeline();
+            string name = m->method().name();
+
+            if ((name == "sort" || name == "sort_by") && p->open()) {
+                p->set_sort(m->arguments());
+                return p;
+            } else if ((name == "join" || name == "size") &&
+                       p->reduce().empty()) {
+                p->set_reduce(name, m->arguments(), m->type());
+                return p;
+            }
+        }
+
+        return e;
+    }
+}
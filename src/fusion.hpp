@@ -0,0 +1,32 @@
+#ifndef __FUSION_H__
+#define __FUSION_H__
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** PipelineFusion class
+     *
+     * Replaces chains of map() and filter() calls, and any sort(), join() or
+     * size() called on the result, with a single Pipeline node:
+     *
+     *   ~~~
+     *   map(^string s: s.upper(), filter(^string s: s != "", l)).join(",")
+     *   ~~~
+     *
+     * becomes a pipeline with the source `l`, a filter and a map stage and a
+     * join reduction, which the backends can generate as a single traversal.
+     * An aggregation (e.g. sum()) of a pipeline is added as a last stage
+     * and reduction of it.
+     */
+    class PipelineFusion : public AST_Rewriter
+    {
+        public:
+            PipelineFusion(symbol::SymbolTable *t)
+                : AST_Rewriter(t) {}
+
+            virtual Expression *rewrite(Expression *);
+    };
+}
+
+#endif
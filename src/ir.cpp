@@ -0,0 +1,841 @@
+#include <cassert>
+#include <map>
+
+#include "ir.hpp"
+#include "accumulate.hpp"
+
+namespace ir {
+
+    using namespace ast;
+
+    static const char *opcode_names[] = {
+        "copy", "not", "add", "sub", "mul", "lt", "le", "gt", "ge", "eq",
+        "bool_eq", "str_lt", "str_le", "str_gt", "str_ge", "str_eq",
+        "str_repeat", "str_concat", "list_concat", "join", "field", "method",
+        "call", "list", "record", "dict", "append",
+        "insert", "group", "accumulate", "write", "if",
+        "else", "end_if", "loop", "end_loop", "switch", "case", "default",
+        "end_switch", "create", "create_text", "macro", "end_macro",
+        "invoke", "memo", "end_memo", "break", "continue"
+    };
+
+    const char *opcode_name(Opcode op)
+    {
+        return opcode_names[op];
+    }
+
+    Operand Operand::make_temp(unsigned n, const Type *t)
+    {
+        Operand o;
+
+        o.kind = TEMP;
+        o.temp = n;
+        o.type = t;
+        return o;
+    }
+
+    Operand Operand::make_symbol(symbol::Symbol *s)
+    {
+        Operand o;
+
+        o.kind = SYMBOL;
+        o.symbol = s;
+        o.type = s->get_type();
+        return o;
+    }
+
+    Operand Operand::make_constant(const ConstantData *c)
+    {
+        Operand o;
+
+        o.kind = CONSTANT;
+        o.constant = c;
+        o.type = c->type();
+        return o;
+    }
+
+    ostream &operator<<(ostream &os, const Operand &o)
+    {
+        switch (o.kind) {
+        case Operand::NONE:
+            break;
+        case Operand::TEMP:
+            os << "%" << o.temp;
+            break;
+        case Operand::SYMBOL:
+            if (o.symbol->argument())
+                os << "$";
+            os << o.symbol->get_name();
+            break;
+        case Operand::CONSTANT:
+            o.constant->print(os);
+            break;
+        }
+        return os;
+    }
+
+    ostream &operator<<(ostream &os, const Instruction &i)
+    {
+        /* The in place instructions are printed with the modified value
+         * as an operand */
+        bool in_place = i.op == LOOP || i.op == APPEND || i.op == INSERT ||
+            i.op == GROUP || i.op == ACCUMULATE;
+
+        if (!i.dest.is_none() && !in_place) {
+            os << i.dest;
+            if (i.dest.kind == Operand::TEMP)
+                os << ":" << i.dest.type->str();
+            os << " = ";
+        }
+        os << opcode_name(i.op);
+        if (!i.name.empty())
+            os << " " << i.name;
+        if (i.op == LOOP)
+            os << " " << i.dest << " in";
+        else if (in_place)
+            os << " " << i.dest << ",";
+
+        size_t key = i.args.size() - i.keys.size();
+        for (size_t n = 0; n < i.args.size(); n++) {
+            os << (n == 0 ? " " : ", ");
+            if (n >= key)
+                os << i.keys[n - key] << "=";
+            os << i.args[n];
+        }
+        return os;
+    }
+
+    Function::~Function()
+    {
+        for (auto c : constants_)
+            delete c;
+    }
+
+    Operand Function::temp(const Type *t)
+    {
+        temps_.push_back(t);
+        return Operand::make_temp(temps_.size() - 1, t);
+    }
+
+    Operand Function::constant(ConstantData *c)
+    {
+        constants_.push_back(c);
+        return Operand::make_constant(c);
+    }
+
+    void Function::print(ostream &os) const
+    {
+        unsigned level = 0;
+
+        /* The cases of a switch are indented one level, and their code
+         * two levels */
+        for (auto &i : code_) {
+            unsigned indent = level;
+
+            switch (i.op) {
+            case ELSE:
+            case CASE:
+            case DEFAULT:
+                indent--;
+                break;
+            case END_IF:
+            case END_LOOP:
+            case END_MACRO:
+            case END_MEMO:
+                indent = --level;
+                break;
+            case END_SWITCH:
+                level -= 2;
+                indent = level;
+                break;
+            default:
+                break;
+            }
+
+            os << string(indent * 4, ' ') << i << "\n";
+
+            if (i.op == IF || i.op == LOOP || i.op == MACRO || i.op == MEMO)
+                level++;
+            else if (i.op == SWITCH)
+                level += 2;
+        }
+    }
+
+    /** Lowers the syntax tree to instructions */
+    class Lowering : public AST_Visitor
+    {
+        public:
+            Lowering(Function *f)
+                : f_(f), value_(), loops_() {}
+
+            Operand lower(Expression *e) {
+                e->accept(*this);
+                return value_;
+            }
+
+            using AST_Visitor::visit;
+
+            virtual void visit(TernaryIf *p) {
+                Operand r = f_->temp(p->type());
+
+                f_->emit(Instruction(IF, Operand(),
+                                     { lower(p->condition()) }));
+                assign(r, lower(p->if_true()));
+                f_->emit(Instruction(ELSE));
+                assign(r, lower(p->if_false()));
+                f_->emit(Instruction(END_IF));
+                value_ = r;
+            }
+            virtual void visit(And *p) {
+                Operand r = f_->temp(p->type());
+
+                assign(r, lower(p->lhs()));
+                f_->emit(Instruction(IF, Operand(), { r }));
+                assign(r, lower(p->rhs()));
+                f_->emit(Instruction(END_IF));
+                value_ = r;
+            }
+            virtual void visit(Or *p) {
+                Operand r = f_->temp(p->type());
+
+                assign(r, lower(p->lhs()));
+                f_->emit(Instruction(IF, Operand(),
+                                     { emit(NOT, p->type(), { r }) }));
+                assign(r, lower(p->rhs()));
+                f_->emit(Instruction(END_IF));
+                value_ = r;
+            }
+            virtual void visit(Not *p) {
+                value_ = emit(NOT, p->type(), { lower(p->expression()) });
+            }
+            virtual void visit(BoolEquals *p) {
+                binary(BOOL_EQ, p);
+            }
+            virtual void visit(LessThan *p) {
+                binary(LT, p);
+            }
+            virtual void visit(LessThanOrEqual *p) {
+                binary(LE, p);
+            }
+            virtual void visit(GreaterThan *p) {
+                binary(GT, p);
+            }
+            virtual void visit(GreaterThanOrEqual *p) {
+                binary(GE, p);
+            }
+            virtual void visit(Equals *p) {
+                binary(EQ, p);
+            }
+            virtual void visit(Plus *p) {
+                binary(ADD, p);
+            }
+            virtual void visit(Minus *p) {
+                binary(SUB, p);
+            }
+            virtual void visit(Times *p) {
+                binary(MUL, p);
+            }
+            virtual void visit(StringLessThan *p) {
+                binary(STR_LT, p);
+            }
+            virtual void visit(StringLessThanOrEqual *p) {
+                binary(STR_LE, p);
+            }
+            virtual void visit(StringGreaterThan *p) {
+                binary(STR_GT, p);
+            }
+            virtual void visit(StringGreaterThanOrEqual *p) {
+                binary(STR_GE, p);
+            }
+            virtual void visit(StringEquals *p) {
+                binary(STR_EQ, p);
+            }
+            virtual void visit(StringRepeat *p) {
+                binary(STR_REPEAT, p);
+            }
+            virtual void visit(StringConcat *p) {
+                binary(STR_CONCAT, p);
+            }
+            virtual void visit(ListConcat *p) {
+                binary(LIST_CONCAT, p);
+            }
+            virtual void visit(Constant *p) {
+                value_ = Operand::make_constant(p->data());
+            }
+            virtual void visit(MethodCall *p) {
+                vector<Operand> args(1, lower(p->expression()));
+
+                lower_list(p->arguments(), args);
+                value_ = emit(METHOD, p->type(), args, p->method().name());
+            }
+            virtual void visit(SymbolRef *p) {
+                value_ = Operand::make_symbol(p->symbol());
+            }
+            virtual void visit(FieldRef *p);
+            virtual void visit(List *p) {
+                vector<Operand> args;
+
+                lower_list(p->elements(), args);
+                value_ = emit(LIST, p->type(), args);
+            }
+            virtual void visit(Record *p) {
+                vector<Operand> args;
+
+                lower_list(p->fields(), args);
+                value_ = emit(RECORD, p->type(), args);
+            }
+            virtual void visit(Dict *p) {
+                vector<Operand> args;
+                auto v = p->values();
+
+                for (auto k = p->keys(); k != nullptr; k = k->next) {
+                    args.push_back(lower(k->expression));
+                    args.push_back(lower(v->expression));
+                    v = v->next;
+                }
+                value_ = emit(DICT, p->type(), args);
+            }
+            virtual void visit(Pipeline *p);
+            virtual void visit(StringJoin *p) {
+                vector<Operand> args;
+
+                lower_list(p->parts(), args);
+                value_ = emit(JOIN, p->type(), args);
+            }
+            virtual void visit(FunctionCall *p);
+
+            virtual void visit(Statements *p) {
+                for (auto s = p; s != nullptr; s = s->next())
+                    s->statement()->accept(*this);
+            }
+            virtual void visit(Conditional *p);
+            virtual void visit(ForEach *p);
+            virtual void visit(ForEachEnum *p) {
+                if (!p->statements())
+                    return;
+
+                Operand l = lower(p->expression());
+
+                f_->emit(Instruction(LOOP, Operand::make_symbol(p->value()),
+                                     { l, Operand::make_symbol(p->index()) }));
+                body(p->statements());
+                f_->emit(Instruction(END_LOOP));
+            }
+
+            /* The branches are lowered by visit(Conditional *) */
+            virtual void visit(If *) {}
+            virtual void visit(Elif *) {}
+            virtual void visit(Else *) {}
+
+            virtual void visit(Text *p) {
+                f_->emit(Instruction(WRITE, Operand(),
+                    { f_->constant(new StringConstantData(p->text())) }));
+            }
+            virtual void visit(InlinedExpression *p) {
+                f_->emit(Instruction(WRITE, Operand(),
+                                     { lower(p->expression()) }));
+            }
+            virtual void visit(VariableList *p) {
+                for (auto v = p; v != nullptr; v = v->next)
+                    v->statement->accept(*this);
+            }
+            virtual void visit(VariableDeclaration *p) {
+                if (p->assignment())
+                    p->assignment()->accept(*this);
+            }
+            virtual void visit(VariableAssignment *p);
+            virtual void visit(Create *p);
+            virtual void visit(Macro *p) {
+                vector<Operand> params;
+
+                for (auto v : p->params())
+                    params.push_back(Operand::make_symbol(v));
+                f_->emit(Instruction(MACRO, Operand(), params, p->name()));
+                body(p->statements());
+                f_->emit(Instruction(END_MACRO));
+            }
+            virtual void visit(MacroCall *p) {
+                vector<Operand> args;
+
+                lower_list(p->arguments(), args);
+                f_->emit(Instruction(INVOKE, Operand(), args,
+                                     p->macro()->name()));
+            }
+            virtual void visit(Memo *p) {
+                f_->emit(Instruction(MEMO, Operand(), { lower(p->key()) }));
+                body(p->statements());
+                f_->emit(Instruction(END_MEMO));
+            }
+            virtual void visit(Break *) {
+                f_->emit(Instruction(BREAK));
+            }
+            virtual void visit(Continue *) {
+                f_->emit(Instruction(CONTINUE));
+            }
+        private:
+            Lowering(const Lowering &) = delete;
+            Lowering &operator=(const Lowering &) = delete;
+
+            /* The temporaries holding the fields of a loop record */
+            struct LoopFields
+            {
+                LoopFields()
+                    : index(), length() {}
+
+                Operand index;
+                Operand length;
+            };
+
+            Operand emit(Opcode op, const Type *t,
+                         const vector<Operand> &args,
+                         const string &name = "") {
+                Operand d = f_->temp(t);
+
+                f_->emit(Instruction(op, d, args, name));
+                return d;
+            }
+
+            /** Stores the value in dest, by letting the instruction that
+             * computed the value write to dest directly if possible */
+            void assign(Operand dest, Operand v) {
+                Instruction *i = f_->last();
+
+                if (v.kind == Operand::TEMP && i && i->op != LOOP &&
+                        i->dest.kind == Operand::TEMP &&
+                        i->dest.temp == v.temp) {
+                    i->dest = dest;
+                    return;
+                }
+                f_->emit(Instruction(COPY, dest, { v }));
+            }
+
+            void binary(Opcode op, BinaryExpression *p) {
+                Operand l = lower(p->lhs());
+                Operand r = lower(p->rhs());
+
+                value_ = emit(op, p->type(), { l, r });
+            }
+
+            void lower_list(ExpressionList *l, vector<Operand> &out) {
+                for (auto e = l; e != nullptr; e = e->next)
+                    out.push_back(lower(e->expression));
+            }
+
+            void body(Statements *s) {
+                if (s)
+                    s->accept(*this);
+            }
+
+            Operand int_constant(int i) {
+                return f_->constant(new IntConstantData(i));
+            }
+
+            Operand first(const LoopFields &l) {
+                return emit(EQ, TypeFactory::get("bool"),
+                            { l.index, int_constant(0) });
+            }
+
+            Operand last(const LoopFields &l) {
+                Operand n = emit(SUB, TypeFactory::get("int"),
+                                 { l.length, int_constant(1) });
+                return emit(EQ, TypeFactory::get("bool"), { l.index, n });
+            }
+
+            /* The accumulator of an aggregation (e.g. sum()), which is
+             * updated with the value of every element in a loop. first is
+             * set for min() and max() until the first element is seen */
+            struct Aggregation
+            {
+                Aggregation()
+                    : name(), acc(), first() {}
+
+                string name;
+                Operand acc;
+                Operand first;
+            };
+
+            Aggregation aggregation(const string &name, const Type *t);
+            void aggregate(const Aggregation &a, Operand v);
+
+            Function *f_;
+            Operand value_;
+            map<symbol::Symbol *, LoopFields> loops_;
+    };
+
+    Lowering::Aggregation Lowering::aggregation(const string &name,
+                                                const Type *t)
+    {
+        Aggregation a;
+        ConstantData *init;
+
+        a.name = name;
+        a.acc = f_->temp(t);
+
+        if (name == "any" || name == "all")
+            init = new BoolConstantData(name == "all");
+        else if (t == TypeFactory::get("string"))
+            init = new StringConstantData("");
+        else
+            init = new IntConstantData(0);
+        assign(a.acc, f_->constant(init));
+
+        if (name == "min" || name == "max") {
+            a.first = f_->temp(TypeFactory::get("bool"));
+            assign(a.first, f_->constant(new BoolConstantData(true)));
+        }
+        return a;
+    }
+
+    void Lowering::aggregate(const Aggregation &a, Operand v)
+    {
+        const Type *t = a.acc.type;
+
+        if (a.name == "sum") {
+            f_->emit(Instruction(ADD, a.acc, { a.acc, v }));
+        } else if (a.name == "count") {
+            f_->emit(Instruction(IF, Operand(), { v }));
+            f_->emit(Instruction(ADD, a.acc, { a.acc, int_constant(1) }));
+            f_->emit(Instruction(END_IF));
+        } else if (a.name == "any" || a.name == "all") {
+            bool any = (a.name == "any");
+
+            if (!any)
+                v = emit(NOT, t, { v });
+            f_->emit(Instruction(IF, Operand(), { v }));
+            assign(a.acc, f_->constant(new BoolConstantData(any)));
+            f_->emit(Instruction(END_IF));
+        } else {
+            bool str = (t == TypeFactory::get("string"));
+            Opcode op = (a.name == "min") ? (str ? STR_LT : LT) :
+                        (str ? STR_GT : GT);
+
+            f_->emit(Instruction(IF, Operand(), { a.first }));
+            assign(a.acc, v);
+            assign(a.first, f_->constant(new BoolConstantData(false)));
+            f_->emit(Instruction(ELSE));
+            f_->emit(Instruction(IF, Operand(),
+                                 { emit(op, TypeFactory::get("bool"),
+                                        { v, a.acc }) }));
+            assign(a.acc, v);
+            f_->emit(Instruction(END_IF));
+            f_->emit(Instruction(END_IF));
+        }
+    }
+
+    void Lowering::visit(FieldRef *p)
+    {
+        SymbolRef *r = p->record()->symbol_ref();
+        auto it = r ? loops_.find(r->symbol()) : loops_.end();
+
+        if (it == loops_.end()) {
+            value_ = emit(FIELD, p->type(), { lower(p->record()) },
+                          p->field());
+            return;
+        }
+
+        string f = p->field();
+        if (f == "index")
+            value_ = it->second.index;
+        else if (f == "length")
+            value_ = it->second.length;
+        else if (f == "first")
+            value_ = first(it->second);
+        else
+            value_ = last(it->second);
+    }
+
+    void Lowering::visit(Pipeline *p)
+    {
+        Operand src = lower(p->source());
+        const Type *elem = p->source()->type()->list()->elem();
+        unsigned filters = 0;
+
+        for (auto &s : p->stages()) {
+            if (s.kind == Pipeline::MAP)
+                elem = s.lambda->expression->type();
+        }
+
+        /* Aggregations are computed in the loop, without a list */
+        bool aggregated = FunctionCall::is_aggregation(p->reduce());
+        Aggregation a;
+        const Type *list_type = TypeFactory::get_list(elem->single());
+        Operand acc;
+        Operand cur = f_->temp(p->source()->type()->list()->elem());
+
+        if (aggregated)
+            a = aggregation(p->reduce(), p->type());
+        else
+            acc = emit(LIST, list_type, {});
+
+        f_->emit(Instruction(LOOP, cur, { src }));
+        for (auto &s : p->stages()) {
+            auto v = s.lambda->variables->statement->variable();
+
+            assign(Operand::make_symbol(v), cur);
+            cur = Operand::make_symbol(v);
+            if (s.kind == Pipeline::MAP) {
+                cur = lower(s.lambda->expression);
+            } else {
+                f_->emit(Instruction(IF, Operand(),
+                                     { lower(s.lambda->expression) }));
+                filters++;
+            }
+        }
+        if (aggregated)
+            aggregate(a, cur);
+        else
+            f_->emit(Instruction(APPEND, acc, { cur }));
+        for (unsigned i = 0; i < filters; i++)
+            f_->emit(Instruction(END_IF));
+        f_->emit(Instruction(END_LOOP));
+
+        if (aggregated) {
+            value_ = a.acc;
+            return;
+        }
+
+        if (p->sort()) {
+            vector<Operand> args(1, acc);
+
+            lower_list(p->sort(), args);
+            acc = emit(METHOD, list_type, args, "sort");
+        }
+
+        if (!p->reduce().empty()) {
+            vector<Operand> args(1, acc);
+
+            lower_list(p->reduce_arguments(), args);
+            acc = emit(METHOD, p->type(), args, p->reduce());
+        }
+        value_ = acc;
+    }
+
+    void Lowering::visit(FunctionCall *p)
+    {
+        LambdaExpression *l = p->args ? p->args->get_lambda(0) : nullptr;
+
+        if (l && (p->name == "map" || p->name == "filter")) {
+            Operand src = lower(p->args->get_expression(1));
+            Operand acc = emit(LIST, p->type(), {});
+            auto v = Operand::make_symbol(
+                l->variables->statement->variable());
+
+            f_->emit(Instruction(LOOP, v, { src }));
+            if (p->name == "map") {
+                f_->emit(Instruction(APPEND, acc, { lower(l->expression) }));
+            } else {
+                f_->emit(Instruction(IF, Operand(), { lower(l->expression) }));
+                f_->emit(Instruction(APPEND, acc, { v }));
+                f_->emit(Instruction(END_IF));
+            }
+            f_->emit(Instruction(END_LOOP));
+            value_ = acc;
+            return;
+        } else if (l && p->name == "index_by") {
+            Operand src = lower(p->args->get_expression(1));
+            Operand acc = emit(DICT, p->type(), {});
+            auto v = Operand::make_symbol(
+                l->variables->statement->variable());
+
+            f_->emit(Instruction(LOOP, v, { src }));
+            f_->emit(Instruction(INSERT, acc, { lower(l->expression), v }));
+            f_->emit(Instruction(END_LOOP));
+            value_ = acc;
+            return;
+        } else if (l && p->name == "group_by") {
+            Operand src = lower(p->args->get_expression(1));
+            Operand acc = emit(LIST, p->type(), {});
+            auto v = Operand::make_symbol(
+                l->variables->statement->variable());
+
+            f_->emit(Instruction(LOOP, v, { src }));
+            f_->emit(Instruction(GROUP, acc, { lower(l->expression), v }));
+            f_->emit(Instruction(END_LOOP));
+            value_ = acc;
+            return;
+        } else if (l && p->name == "distinct") {
+            /* The keys that have been seen are kept in a dict */
+            const PrimitiveType *key = l->expression->type()->primitive();
+            const SingleType *elem = p->type()->list()->elem();
+            Operand src = lower(p->args->get_expression(1));
+            Operand acc = emit(LIST, p->type(), {});
+            Operand seen = emit(DICT, TypeFactory::get_dict(key, elem), {});
+            auto v = Operand::make_symbol(
+                l->variables->statement->variable());
+
+            f_->emit(Instruction(LOOP, v, { src }));
+            Operand k = lower(l->expression);
+            Operand has = emit(METHOD, TypeFactory::get("bool"), { seen, k },
+                               "has");
+            f_->emit(Instruction(IF, Operand(),
+                                 { emit(NOT, TypeFactory::get("bool"),
+                                        { has }) }));
+            f_->emit(Instruction(INSERT, seen, { k, v }));
+            f_->emit(Instruction(APPEND, acc, { v }));
+            f_->emit(Instruction(END_IF));
+            f_->emit(Instruction(END_LOOP));
+            value_ = acc;
+            return;
+        } else if (l && p->aggregation()) {
+            Operand src = lower(p->args->get_expression(1));
+            Aggregation a = aggregation(p->name, p->type());
+            auto v = Operand::make_symbol(
+                l->variables->statement->variable());
+
+            f_->emit(Instruction(LOOP, v, { src }));
+            aggregate(a, lower(l->expression));
+            f_->emit(Instruction(END_LOOP));
+            value_ = a.acc;
+            return;
+        } else if (l && p->name == "reduce") {
+            Operand src = lower(p->args->get_expression(1));
+            Operand acc = f_->temp(p->type());
+            auto v = Operand::make_symbol(
+                l->variables->next->statement->variable());
+
+            assign(acc, lower(p->args->get_expression(2)));
+            f_->emit(Instruction(LOOP, v, { src }));
+            assign(Operand::make_symbol(l->variables->statement->variable()),
+                   acc);
+            assign(acc, lower(l->expression));
+            f_->emit(Instruction(END_LOOP));
+            value_ = acc;
+            return;
+        }
+
+        /* Other builtins only take expression arguments */
+        vector<Operand> args;
+        for (auto a = p->args; a != nullptr; a = a->next) {
+            assert(a->arg->expression());
+            args.push_back(lower(a->arg->expression()->value));
+        }
+        value_ = emit(CALL, p->type(), args, p->name);
+    }
+
+    void Lowering::visit(Conditional *p)
+    {
+        if (p->dispatch_subject()) {
+            auto &keys = p->dispatch_keys();
+            size_t i = 0;
+
+            f_->emit(Instruction(SWITCH, Operand(),
+                                 { lower(p->dispatch_subject()) }));
+            f_->emit(Instruction(CASE, Operand(),
+                { Operand::make_constant(keys[i++]->data()) }));
+            body(p->if_node()->statements());
+            for (auto e = p->elif_nodes(); e != nullptr; e = e->next()) {
+                f_->emit(Instruction(CASE, Operand(),
+                    { Operand::make_constant(keys[i++]->data()) }));
+                body(e->statements());
+            }
+            if (p->else_node() && p->else_node()->statements()) {
+                f_->emit(Instruction(DEFAULT));
+                body(p->else_node()->statements());
+            }
+            f_->emit(Instruction(END_SWITCH));
+            return;
+        }
+
+        unsigned open = 1;
+
+        f_->emit(Instruction(IF, Operand(),
+                             { lower(p->if_node()->condition()) }));
+        body(p->if_node()->statements());
+        for (auto e = p->elif_nodes(); e != nullptr; e = e->next()) {
+            f_->emit(Instruction(ELSE));
+            f_->emit(Instruction(IF, Operand(), { lower(e->condition()) }));
+            body(e->statements());
+            open++;
+        }
+        if (p->else_node() && p->else_node()->statements()) {
+            f_->emit(Instruction(ELSE));
+            body(p->else_node()->statements());
+        }
+        for (unsigned i = 0; i < open; i++)
+            f_->emit(Instruction(END_IF));
+    }
+
+    void Lowering::visit(ForEach *p)
+    {
+        if (!p->statements())
+            return;
+
+        Operand l = lower(p->expression());
+        auto usage = optimizer::record_usage(p->statements(),
+                                             p->loop_variable());
+        LoopFields fields;
+        vector<Operand> args(1, l);
+
+        if (usage.uses("length") || usage.uses("last"))
+            fields.length = emit(METHOD, TypeFactory::get("int"), { l },
+                                 "size");
+        if (usage.used()) {
+            fields.index = f_->temp(TypeFactory::get("int"));
+            args.push_back(fields.index);
+        }
+
+        f_->emit(Instruction(LOOP, Operand::make_symbol(p->variable()),
+                             args));
+        if (usage.whole) {
+            /* The record is used as a value, build it in every
+             * iteration */
+            f_->emit(Instruction(RECORD,
+                Operand::make_symbol(p->loop_variable()),
+                { fields.index, first(fields), last(fields),
+                  fields.length }));
+        } else if (usage.used()) {
+            loops_[p->loop_variable()] = fields;
+        }
+        body(p->statements());
+        f_->emit(Instruction(END_LOOP));
+        loops_.erase(p->loop_variable());
+    }
+
+    void Lowering::visit(VariableAssignment *p)
+    {
+        Operand v = Operand::make_symbol(p->variable());
+
+        if (!p->accumulate()) {
+            assign(v, lower(p->expression()));
+            return;
+        }
+
+        for (auto e : optimizer::accumulated_parts(p)) {
+            List *l = e->list();
+
+            if (l && l->elements() && !l->elements()->next)
+                f_->emit(Instruction(APPEND, v,
+                                     { lower(l->elements()->expression) }));
+            else
+                f_->emit(Instruction(ACCUMULATE, v, { lower(e) }));
+        }
+    }
+
+    void Lowering::visit(Create *p)
+    {
+        Instruction i(p->rendered ? CREATE_TEXT : CREATE, Operand(),
+                      { lower(p->out),
+                        f_->constant(new BoolConstantData(p->ow_ask)) },
+                      p->tgl);
+
+        if (p->rendered) {
+            i.args.push_back(f_->constant(new StringConstantData(p->text)));
+        } else {
+            for (auto &a : p->args) {
+                i.args.push_back(lower(a.second));
+                i.keys.push_back(a.first);
+            }
+        }
+        f_->emit(i);
+    }
+
+    Function *lower(Statements *body)
+    {
+        Function *f = new Function;
+        Lowering l(f);
+
+        if (body)
+            body->accept(l);
+        return f;
+    }
+}
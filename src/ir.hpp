@@ -0,0 +1,246 @@
+#ifndef __IR_H__
+#define __IR_H__
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "ast.hpp"
+#include "constant.hpp"
+#include "symbol.hpp"
+#include "type.hpp"
+
+namespace ir {
+
+    /** The instruction opcodes
+     *
+     * Most instructions compute a value from their operands and store it in
+     * the destination. The structured control flow instructions (IF, LOOP,
+     * SWITCH, ...) mark the start and the end of nested code; the code
+     * between them is still a part of the linear instruction sequence.
+     */
+    enum Opcode {
+        /* dest = args[0] */
+        COPY,
+
+        /* dest = not args[0] */
+        NOT,
+
+        /* dest = args[0] <op> args[1] */
+        ADD,
+        SUB,
+        MUL,
+        LT,
+        LE,
+        GT,
+        GE,
+        EQ,
+        BOOL_EQ,
+        STR_LT,
+        STR_LE,
+        STR_GT,
+        STR_GE,
+        STR_EQ,
+        STR_REPEAT,
+        STR_CONCAT,
+        LIST_CONCAT,
+
+        /* dest = args[0] + args[1] + ... (strings) */
+        JOIN,
+
+        /* dest = args[0].name */
+        FIELD,
+        /* dest = args[0].name(args[1], ...), where name is a method of the
+         * type of args[0] */
+        METHOD,
+        /* dest = name(args[0], ...), a builtin function */
+        CALL,
+
+        /* dest = a new list or record holding the arguments */
+        LIST,
+        RECORD,
+        /* dest = a new dict mapping args[0] to args[1], args[2] to args[3],
+         * ... */
+        DICT,
+
+        /* Appends args[0] to the list dest in place */
+        APPEND,
+        /* Maps the key args[0] to args[1] in the dict dest in place */
+        INSERT,
+        /* Appends args[1] to the items of the group record with the key
+         * args[0] in the list dest in place, adding the group at the end
+         * of the list if there's no such group */
+        GROUP,
+        /* Appends the string or list args[0] to dest in place (dest is
+         * known to not be shared with any other variable) */
+        ACCUMULATE,
+
+        /* Writes the string args[0] to the output */
+        WRITE,
+
+        /* if args[0] ... [else ...] end_if */
+        IF,
+        ELSE,
+        END_IF,
+
+        /* Runs the code up to the matching END_LOOP once for each element
+         * in the list args[0], with the element in dest. If args[1] is
+         * given, it's set to the index of the element */
+        LOOP,
+        END_LOOP,
+
+        /* Runs the code after the CASE whose constant args[0] is equal to
+         * the SWITCH's args[0], or after the DEFAULT if no CASE matches */
+        SWITCH,
+        CASE,
+        DEFAULT,
+        END_SWITCH,
+
+        /* Creates the file args[0] from the template name, with the keyword
+         * arguments args[2], ... named by keys. args[1] tells if the user
+         * should be asked before overwriting an existing file */
+        CREATE,
+        /* Creates the file args[0] with the content args[2], a template
+         * that was rendered at compile time */
+        CREATE_TEXT,
+
+        /* Defines the macro name with the parameters args[0], ..., whose
+         * body is the code up to the matching END_MACRO. The body is only
+         * run by INVOKE */
+        MACRO,
+        END_MACRO,
+        /* Runs the body of the macro name with the parameters set to
+         * args[0], ... */
+        INVOKE,
+
+        /* Runs the code up to the matching END_MEMO unless it has been run
+         * with an equal key args[0] before, in which case the output of that
+         * run is written */
+        MEMO,
+        END_MEMO,
+
+        /* Leaves the innermost LOOP */
+        BREAK,
+        /* Continues with the next iteration of the innermost LOOP */
+        CONTINUE
+    };
+
+    /** Returns the name of the opcode */
+    const char *opcode_name(Opcode);
+
+    /** Operand struct
+     *
+     * An operand is either a temporary, a symbol (an argument or a
+     * variable), or a constant.
+     */
+    struct Operand
+    {
+        enum Kind {
+            NONE,
+            TEMP,
+            SYMBOL,
+            CONSTANT
+        };
+
+        Operand()
+            : kind(NONE), temp(0), symbol(nullptr), constant(nullptr),
+              type(nullptr) {}
+
+        static Operand make_temp(unsigned n, const Type *t);
+        static Operand make_symbol(symbol::Symbol *s);
+        static Operand make_constant(const ConstantData *c);
+
+        bool is_none() const {
+            return kind == NONE;
+        }
+
+        Kind kind;
+        unsigned temp;
+        symbol::Symbol *symbol;
+        const ConstantData *constant;
+        const Type *type;
+    };
+
+    ostream &operator<<(ostream &, const Operand &);
+
+    /** Instruction struct
+     *
+     */
+    struct Instruction
+    {
+        Instruction(Opcode op, Operand dest = Operand(),
+                    const vector<Operand> &args = vector<Operand>(),
+                    const string &name = "")
+            : op(op), dest(dest), args(args), name(name), keys() {}
+
+        Opcode op;
+        Operand dest;
+        vector<Operand> args;
+
+        /* The field, method, template or macro name */
+        string name;
+        /* The keyword argument names of a CREATE */
+        vector<string> keys;
+    };
+
+    ostream &operator<<(ostream &, const Instruction &);
+
+    /** Function class
+     *
+     * Holds the instructions lowered from a template body, and the
+     * temporaries and constants used by them.
+     */
+    class Function
+    {
+        public:
+            Function()
+                : code_(), temps_(), constants_() {}
+
+            ~Function();
+
+            const vector<Instruction> &code() const {
+                return code_;
+            }
+            /** Returns the types of the temporaries, indexed by number */
+            const vector<const Type *> &temps() const {
+                return temps_;
+            }
+
+            /** Creates a new temporary of the given type */
+            Operand temp(const Type *);
+
+            /** Creates a constant owned by the function */
+            Operand constant(ConstantData *);
+
+            void emit(const Instruction &i) {
+                code_.push_back(i);
+            }
+            /** Returns the last emitted instruction, or nullptr */
+            Instruction *last() {
+                return code_.empty() ? nullptr : &code_.back();
+            }
+
+            void print(ostream &) const;
+        private:
+            Function(const Function &) = delete;
+            Function &operator=(const Function &) = delete;
+
+            vector<Instruction> code_;
+            vector<const Type *> temps_;
+            vector<ConstantData *> constants_;
+    };
+
+    /** Lowers a template body to a function
+     *
+     * @details The lowering makes everything that the backends would
+     * otherwise derive on their own explicit: temporaries for every
+     * intermediate value, short circuit evaluation as IF instructions,
+     * map(), filter() and pipelines as loops, and the fields of the loop
+     * records as index and length computations.
+     */
+    Function *lower(ast::Statements *);
+}
+
+#endif
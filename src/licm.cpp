@@ -0,0 +1,96 @@
+#include <map>
+
+#include "licm.hpp"
+
+namespace optimizer {
+
+    /** Replaces the loop invariant expressions in a loop body with
+     * references to temporaries, and collects the declarations of the
+     * temporaries */
+    class InvariantHoister : public AST_Rewriter
+    {
+        public:
+            InvariantHoister(Scope *loop, symbol::SymbolTable *for_table,
+                             symbol::SymbolTable *outer,
+                             const set<symbol::Symbol *> &assigned)
+                : AST_Rewriter(for_table), outer_(outer),
+                  assigned_(assigned), decls_(nullptr), last_(nullptr),
+                  temps_() {
+                /* The loop variables live in the for table, and everything
+                 * declared in the body in the body's table (or in tables
+                 * below it) */
+                tables_.push_back(loop->table());
+            }
+
+            virtual Expression *rewrite(Expression *e) {
+                if (!is_trivial(e) && invariant(e) && is_speculatable(e)) {
+                    /* Identical expressions share the same temporary */
+                    string key = structural_key(e);
+                    auto it = temps_.find(key);
+                    if (it != temps_.end())
+                        return new SymbolRef(it->second);
+
+                    auto v = create_temporary(outer_, e->type(), "licm");
+                    auto l = new VariableList(new VariableDeclaration(v, e),
+                                              nullptr);
+                    if (last_)
+                        last_->next = l;
+                    else
+                        decls_ = l;
+                    last_ = l;
+                    temps_[key] = v;
+
+                    return new SymbolRef(v);
+                }
+                return AST_Rewriter::rewrite(e);
+            }
+
+            VariableList *declarations() {
+                return decls_;
+            }
+        private:
+            InvariantHoister(const InvariantHoister &) = delete;
+            InvariantHoister &operator=(const InvariantHoister &) = delete;
+
+            bool invariant(Expression *e) {
+                for (auto s : free_symbols(e)) {
+                    if (assigned_.find(s) != assigned_.end() ||
+                            defined_in_tables(s))
+                        return false;
+                }
+                return true;
+            }
+
+            symbol::SymbolTable *outer_;
+            const set<symbol::Symbol *> &assigned_;
+            VariableList *decls_;
+            VariableList *last_;
+            map<string, symbol::Variable *> temps_;
+    };
+
+    void LoopInvariantCodeMotion::visit(ForEach *p)
+    {
+        if (p->statements())
+            hoist(p, p->for_table());
+        AST_Rewriter::visit(p);
+    }
+
+    void LoopInvariantCodeMotion::visit(ForEachEnum *p)
+    {
+        if (p->statements())
+            hoist(p, p->for_table());
+        AST_Rewriter::visit(p);
+    }
+
+    void LoopInvariantCodeMotion::hoist(Scope *loop,
+                                        symbol::SymbolTable *for_table)
+    {
+        auto assigned = assigned_variables(loop->statements());
+        InvariantHoister h(loop, for_table, current_table(), assigned);
+
+        loop->statements()->accept(h);
+
+        if (h.declarations())
+            insert_before(h.declarations());
+    }
+}
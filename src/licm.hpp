@@ -0,0 +1,49 @@
+#ifndef __LICM_H__
+#define __LICM_H__
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** LoopInvariantCodeMotion class
+     *
+     * Moves expressions in for loop bodies that doesn't depend on anything
+     * that changes between the iterations (i.e. the loop variables, variables
+     * declared in the loop or variables assigned in the loop) out of the loop.
+     * Each hoisted expression is bound to a compiler generated variable that
+     * is declared just before the loop:
+     *
+     *   ~~~
+     *   % for s in list
+     *   {{ title.upper() }}: {{ s }}
+     *   % endfor
+     *   ~~~
+     *
+     * is rewritten to
+     *
+     *   ~~~
+     *   % with string __licm0 = title.upper()
+     *   % for s in list
+     *   {{ __licm0 }}: {{ s }}
+     *   % endfor
+     *   ~~~
+     *
+     * @details Since the hoisted expressions are evaluated even if the loop
+     * doesn't run (or if they were placed in a branch that isn't taken), only
+     * expressions that can't fail are moved.
+     */
+    class LoopInvariantCodeMotion : public AST_Rewriter
+    {
+        public:
+            LoopInvariantCodeMotion(symbol::SymbolTable *t)
+                : AST_Rewriter(t) {}
+
+            using AST_Rewriter::visit;
+            virtual void visit(ForEach *);
+            virtual void visit(ForEachEnum *);
+        private:
+            void hoist(Scope *, symbol::SymbolTable *);
+    };
+}
+
+#endif
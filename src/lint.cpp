@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "accumulate.hpp"
+#include "lint.hpp"
+
+namespace lint {
+
+    using namespace ast;
+    using ast_rewriter::AST_Rewriter;
+
+    /** Collects the variables that are declared by statements */
+    class DeclarationCollector : public AST_Rewriter
+    {
+        public:
+            DeclarationCollector()
+                : AST_Rewriter(nullptr), declared() {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(VariableDeclaration *p) {
+                declared.insert(p->variable());
+                AST_Rewriter::visit(p);
+            }
+
+            set<symbol::Symbol *> declared;
+    };
+
+    /** Returns the name of the expression for use in a message, if it's a
+     * symbol reference, and a description of it otherwise */
+    static string describe(Expression *e, const string &otherwise)
+    {
+        SymbolRef *r = e->symbol_ref();
+
+        return r ? "'" + r->symbol()->get_name() + "'" : otherwise;
+    }
+
+    /** Returns true if the lambda compares its variable to something else,
+     * i.e. if a filter() with it looks for the elements equal to a value */
+    static bool is_equality_lambda(LambdaExpression *l)
+    {
+        Expression *lhs, *rhs;
+
+        if (l->variables == nullptr || l->variables->next != nullptr)
+            return false;
+
+        if (Equals *e = l->expression->equals()) {
+            lhs = e->lhs();
+            rhs = e->rhs();
+        } else if (StringEquals *e = l->expression->string_equals()) {
+            lhs = e->lhs();
+            rhs = e->rhs();
+        } else {
+            return false;
+        }
+
+        auto v = l->variables->statement->variable();
+        auto is_var = [&](Expression *e) {
+            return e->symbol_ref() && e->symbol_ref()->symbol() == v;
+        };
+        return is_var(lhs) || is_var(rhs);
+    }
+
+    /** Walks the body and collects the findings */
+    class PerfLinter : public AST_Rewriter
+    {
+        public:
+            PerfLinter()
+                : AST_Rewriter(nullptr), findings(), loops_(), bound_(),
+                  wraps_(), line_(0) {}
+
+            using AST_Rewriter::visit;
+
+            virtual Statement *rewrite_statement(Statement *s) {
+                int saved = line_;
+
+                enter(s);
+                AST_Rewriter::rewrite_statement(s);
+                line_ = saved;
+                return s;
+            }
+
+            virtual void visit(ForEach *p) {
+                p->set_expression(rewrite(p->expression()));
+                loop(p, p->expression(),
+                     { p->variable(), p->loop_variable() });
+            }
+
+            virtual void visit(ForEachEnum *p) {
+                p->set_expression(rewrite(p->expression()));
+                loop(p, p->expression(), { p->index(), p->value() });
+            }
+
+            virtual void visit(If *p) {
+                enter(p);
+                AST_Rewriter::visit(p);
+            }
+
+            virtual void visit(Elif *p) {
+                enter(p);
+                AST_Rewriter::visit(p);
+            }
+
+            virtual void visit(VariableDeclaration *p) {
+                enter(p);
+                AST_Rewriter::visit(p);
+            }
+
+            virtual void visit(VariableAssignment *p);
+            virtual void visit(MethodCall *);
+            virtual void visit(FunctionCall *);
+
+            virtual void visit(LambdaExpression *p) {
+                for (auto v = p->variables; v != nullptr; v = v->next)
+                    bound_.insert(v->statement->variable());
+                AST_Rewriter::visit(p);
+            }
+
+            vector<Finding> findings;
+        private:
+            /** The loops that are being visited */
+            struct Loop
+            {
+                int line;
+                Expression *list;
+                /* The variables declared in the loop, and every variable
+                 * that may have another value in the next iteration */
+                set<symbol::Symbol *> declared;
+                set<symbol::Symbol *> variant;
+            };
+
+            void enter(Statement *s) {
+                if (s->line() != 0)
+                    line_ = s->line();
+            }
+
+            void loop(Scope *, Expression *,
+                      const vector<symbol::Symbol *> &);
+
+            /** Returns true if the expression may have another value in the
+             * next iteration of the innermost loop, not counting the ignored
+             * symbols */
+            bool varies(Expression *, const set<symbol::Symbol *> &ignored =
+                        set<symbol::Symbol *>()) const;
+
+            void report(const string &message, const string &suggestion) {
+                findings.push_back({ line_, message, suggestion });
+            }
+
+            string in_loop() const {
+                stringstream ss;
+
+                ss << "in every iteration of the loop on line "
+                   << loops_.back().line;
+                return ss.str();
+            }
+
+            vector<Loop> loops_;
+            set<symbol::Symbol *> bound_;
+            map<string, int> wraps_;
+            int line_;
+    };
+
+    void PerfLinter::loop(Scope *p, Expression *list,
+                          const vector<symbol::Symbol *> &variables)
+    {
+        if (!p->statements())
+            return;
+
+        DeclarationCollector c;
+        p->statements()->accept(c);
+
+        Loop l = { line_, list, c.declared,
+                   optimizer::assigned_variables(p->statements()) };
+        l.variant.insert(variables.begin(), variables.end());
+        l.variant.insert(c.declared.begin(), c.declared.end());
+
+        loops_.push_back(l);
+        p->set_statements(rewrite_block(p->statements()));
+        loops_.pop_back();
+    }
+
+    bool PerfLinter::varies(Expression *e,
+                            const set<symbol::Symbol *> &ignored) const
+    {
+        const Loop &l = loops_.back();
+
+        for (auto s : optimizer::free_symbols(e)) {
+            if (ignored.count(s))
+                continue;
+            if (l.variant.count(s) || bound_.count(s))
+                return true;
+        }
+        return false;
+    }
+
+    void PerfLinter::visit(VariableAssignment *p)
+    {
+        enter(p);
+        AST_Rewriter::visit(p);
+
+        auto v = p->variable();
+
+        if (loops_.empty() || loops_.back().declared.count(v) ||
+                optimizer::accumulated_parts(p).empty())
+            return;
+
+        string name = "'" + v->get_name() + "'";
+
+        if (v->get_type()->list()) {
+            report(name + " is copied to append to it " + in_loop() +
+                   ", which is quadratic in the length of the list",
+                   "build the list with map() and filter(), or don't read " +
+                   name + " in the loop so that it can be appended to in "
+                   "place");
+        } else {
+            report(name + " is copied to append to it " + in_loop() +
+                   ", which is quadratic in the length of the string",
+                   "collect the parts in a list and join() it after the "
+                   "loop, or don't read " + name + " in the loop so that "
+                   "it can be appended to in place");
+        }
+    }
+
+    void PerfLinter::visit(MethodCall *p)
+    {
+        AST_Rewriter::visit(p);
+
+        auto name = p->method().name();
+        auto object = p->expression();
+
+        FunctionCall *f = object->function_call();
+
+        if (name == "size" && f && f->name == "filter" && f->args &&
+                f->args->get_lambda(0) &&
+                is_equality_lambda(f->args->get_lambda(0))) {
+            Expression *list = f->args->get_expression(1);
+
+            report("filter() builds a list to test if a value is in " +
+                   describe(list, "a list"),
+                   "build a set of the elements once with set() and test "
+                   "with 'in'");
+        } else if ((name == "sort" || name == "sort_by") && !loops_.empty() &&
+                   !varies(object)) {
+            if (optimizer::structural_key(object) ==
+                    optimizer::structural_key(loops_.back().list)) {
+                report("the list that is looped over is sorted " +
+                       in_loop(),
+                       "sort the list once before the loop (e.g. loop over "
+                       "the sorted list)");
+            } else {
+                report(describe(object, "a list") + " is sorted " +
+                       in_loop() + ", but doesn't change in the loop",
+                       "sort it once before the loop and bind it with "
+                       "'with'");
+            }
+        } else if (name == "wrap") {
+            string key = optimizer::structural_key(p);
+            auto it = wraps_.find(key);
+
+            if (it != wraps_.end() && it->second != line_) {
+                stringstream ss;
+
+                ss << describe(object, "the string") << " is wrapped the "
+                   "same way as on line " << it->second;
+                report(ss.str(), "wrap it once and bind the result with "
+                       "'with'");
+            } else if (!loops_.empty() && !varies(p)) {
+                report(describe(object, "a string") + " is wrapped " +
+                       in_loop() + ", but doesn't change in the loop",
+                       "wrap it once before the loop and bind the result "
+                       "with 'with'");
+            }
+
+            if (it == wraps_.end())
+                wraps_[key] = line_;
+        }
+    }
+
+    void PerfLinter::visit(FunctionCall *p)
+    {
+        AST_Rewriter::visit(p);
+
+        if (p->name == "any" && p->args && p->args->get_lambda(0) &&
+                is_equality_lambda(p->args->get_lambda(0))) {
+            report("any() scans " +
+                   describe(p->args->get_expression(1), "a list") +
+                   " to test if a value is in it",
+                   "build a set of the elements once with set() and test "
+                   "with 'in'");
+            return;
+        }
+
+        if (p->name != "filter" || loops_.empty() || !p->args)
+            return;
+
+        Expression *list = p->args->get_expression(1);
+        LambdaExpression *lambda = p->args->get_lambda(0);
+
+        if (!list || !lambda || varies(list))
+            return;
+
+        /* The lambda's own variables change for every element */
+        set<symbol::Symbol *> own;
+        for (auto v = lambda->variables; v != nullptr; v = v->next)
+            own.insert(v->statement->variable());
+
+        if (!varies(lambda->expression, own))
+            return;
+
+        report("filter() scans " + describe(list, "a list") + " " +
+               in_loop() + " (a nested loop join, quadratic in the length "
+               "of the lists)",
+               "group the list by the key once before the loop with "
+               "group_by() or index_by(), or sort both lists by the key and "
+               "walk them together");
+    }
+
+    vector<Finding> perf_lint(Statements *body)
+    {
+        PerfLinter l;
+
+        if (body)
+            l.rewrite_block(body);
+
+        stable_sort(l.findings.begin(), l.findings.end(),
+                    [](const Finding &a, const Finding &b) {
+                        return a.line < b.line;
+                    });
+        return l.findings;
+    }
+
+    void print(ostream &os, const string &name, const vector<Finding> &v)
+    {
+        string prefix = name.empty() ? "" : name + ":";
+
+        for (auto &f : v) {
+            os << prefix << f.line << ": warning: " << f.message << "\n";
+            os << prefix << f.line << ": note: " << f.suggestion << "\n";
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef __LINT_H__
+#define __LINT_H__
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "ast.hpp"
+
+namespace lint {
+
+    /** Finding struct
+     *
+     * A pattern in a template that makes the generated script slow, and a
+     * cheaper construct that could be used instead.
+     */
+    struct Finding
+    {
+        int line;
+        string message;
+        string suggestion;
+    };
+
+    /** Finds patterns in a (not yet optimized) template body that make the
+     * generated script slow:
+     *
+     * - filter() calls in loops that scan a list that doesn't change in the
+     *   loop, with a lambda that depends on the loop (a nested loop join)
+     * - variables that are built up with x = x + ... in loops
+     * - sort() calls in loops on lists that don't change in the loop
+     * - wrap() calls that wrap the same string more than once
+     * - filter(...).size() membership tests, where a set would do
+     *
+     * The findings are returned in line order.
+     */
+    vector<Finding> perf_lint(ast::Statements *);
+
+    /** Prints the findings on the same form as the parser's warnings */
+    void print(ostream &, const string &name, const vector<Finding> &);
+}
+
+#endif
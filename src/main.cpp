@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include <unistd.h>
 #include <fstream>
@@ -9,7 +10,11 @@
 
 #include "ast.hpp"
 #include "ast_printer.hpp"
+#include "binding.hpp"
 #include "data.hpp"
+#include "ir.hpp"
+#include "lint.hpp"
+#include "optimizer.hpp"
 #include "type.hpp"
 
 #include "bash_backend.hpp"
@@ -23,22 +28,39 @@ extern int yyparse(ParseContext *);
 
 void usage(ostream &os, const char *cmd)
 {
-    os << "usage: " << cmd << " [-h] [-b BACKEND] [-o OUTFILE] [INFILE]\n";
+    os << "usage: " << cmd << " [-h] [-b BACKEND] [-o OUTFILE] [-O LEVEL] "
+        "[-D NAME=VALUE] [INFILE]\n";
     os << "\n";
     os << " -h, --help          show this help message and exit\n";
     os << " -b BACKEND          select the backend\n";
     os << " -o FILE             output to FILE\n";
     os << " -s, --stdout        output to stdout\n";
     os << " -t, --tgp           use the tgp backend instead\n";
+    os << " -D NAME=VALUE       bind the argument NAME to VALUE at compile "
+        "time. VALUE\n";
+    os << "                     is written as the default value in the "
+        "header\n";
     os << " -x, --exec          execute the generated script. all arguments "
         "passed after '--' are fed to the script.\n";
     os << "                     this will create an a.out file if the -s "
         "option is also used\n";
+    os << " -O0, -O1, -O2       set the optimization level (default: -O2)\n";
+    os << " -fPASS, -fno-PASS   enable or disable an optimization pass\n";
+    os << " --dump-after=PASS   print the syntax tree after PASS\n";
+    os << " --print-ir          print the intermediate representation of the "
+        "optimized\n";
+    os << "                     files\n";
+    os << " --perf-lint         report patterns that make the generated "
+        "script slow,\n";
+    os << "                     instead of generating it\n";
     os << "\n";
     os << "Available backends\n";
     os << " bash                Bash (4.0+) backend (unfinished)\n";
     os << " py                  Python (2.7+) backend\n";
     os << " pygtk               PyGTK backend\n";
+    os << "\n";
+    os << "Optimization passes\n";
+    optimizer::PassManager::print_passes(os);
 }
 
 Backend *get_tgl_backend(const string &str)
@@ -80,6 +102,46 @@ void generate_tgp(ostream &os, const string &backend,
     b->generate(os, tgp_data, tgl_data);
 }
 
+/** Parses the value bound to an argument with -D, with the same rules as the
+ * default value of an argument in the header */
+ConstantData *parse_binding(symbol::Argument *a, const string &value)
+{
+    string header = "arg " + a->get_type()->str() + " " + a->get_name() +
+        " { default = " + value + "; }\n%%\n";
+    FILE *fp = fmemopen((void *)header.c_str(), header.size(), "r");
+    ConstantData *data = nullptr;
+
+    if (fp == nullptr) {
+        error() << "failed to parse -D " << a->get_name() << " ("
+                << strerror(errno) << ")\n";
+        return nullptr;
+    }
+
+    ParseContext *context = new ParseContext("-D " + a->get_name(), fp);
+
+    if (yyparse(context) == 0) {
+        if (context->data->arguments.size() == 1)
+            data = copy_constant(
+                context->data->arguments[0]->get("default")->get());
+        else
+            error() << "invalid value for -D " << a->get_name() << "\n";
+    }
+
+    fclose(fp);
+    return data;
+}
+
+/** Parses a .tgl file again, to get a copy of its syntax tree */
+ParseData *parse_tgl(const string &path)
+{
+    FILE *fp = load_file(path.c_str());
+    ParseContext *context = new ParseContext(path, fp, false);
+    bool success = (yyparse(context) == 0);
+
+    fclose(fp);
+    return success ? context->data : nullptr;
+}
+
 void execute(const string file, const string &backend, char **exec_args)
 {
     if (backend.empty() || backend == "py") {
@@ -118,6 +180,8 @@ int main(int argc, char **argv)
     string backend = "";
     bool print_ast = false;
     bool print_types = false;
+    bool print_ir = false;
+    bool perf_lint = false;
     bool success;
     bool tgp = false;
     bool use_stdout = false;
@@ -128,6 +192,8 @@ int main(int argc, char **argv)
     FILE *fp;
     string name;
     ParseContext *context;
+    optimizer::PassManager passes;
+    vector<pair<string, string> > defines;
 
     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
@@ -158,6 +224,57 @@ int main(int argc, char **argv)
             print_ast = true;
         } else if (!strcmp(argv[i], "--print-types")) {
             print_types = true;
+        } else if (!strcmp(argv[i], "--print-ir")) {
+            print_ir = true;
+        } else if (!strcmp(argv[i], "--perf-lint")) {
+            perf_lint = true;
+        } else if (!strncmp(argv[i], "-D", 2)) {
+            const char *d = argv[i] + 2;
+
+            if (*d == '\0') {
+                if (++i == argc) {
+                    usage(cerr, argv[0]);
+                    error() << "argument '-D' expects one argument\n";
+                    return 1;
+                }
+                d = argv[i];
+            }
+
+            const char *eq = strchr(d, '=');
+
+            if (eq == nullptr || eq == d) {
+                usage(cerr, argv[0]);
+                error() << "argument '-D' expects NAME=VALUE\n";
+                return 1;
+            }
+            defines.push_back(make_pair(string(d, eq - d), string(eq + 1)));
+        } else if (!strcmp(argv[i], "-O0") || !strcmp(argv[i], "-O1") ||
+                   !strcmp(argv[i], "-O2")) {
+            passes.set_level(argv[i][2] - '0');
+        } else if (!strncmp(argv[i], "-fno-", 5)) {
+            try {
+                passes.set_enabled(argv[i] + 5, false);
+            } catch (const optimizer::UnknownPass &e) {
+                usage(cerr, argv[0]);
+                error() << e.what() << endl;
+                return 1;
+            }
+        } else if (!strncmp(argv[i], "-f", 2)) {
+            try {
+                passes.set_enabled(argv[i] + 2, true);
+            } catch (const optimizer::UnknownPass &e) {
+                usage(cerr, argv[0]);
+                error() << e.what() << endl;
+                return 1;
+            }
+        } else if (!strncmp(argv[i], "--dump-after=", 13)) {
+            try {
+                passes.set_dump_after(argv[i] + 13);
+            } catch (const optimizer::UnknownPass &e) {
+                usage(cerr, argv[0]);
+                error() << e.what() << endl;
+                return 1;
+            }
         } else if (!strcmp(argv[i], "--")) {
             exec_args = &argv[i + 1];
             break;
@@ -209,6 +326,68 @@ int main(int argc, char **argv)
     if (!success)
         return 1;
 
+    /* Report slow patterns in the templates as they were written */
+    if (perf_lint) {
+        lint::print(cerr, name, lint::perf_lint(context->data->body));
+
+        if (tgp) {
+            auto files = context->parsed_files();
+            for (auto it = files.begin(); it != files.end(); ++it)
+                lint::print(cerr, it->first,
+                            lint::perf_lint(it->second->body));
+        }
+        return 0;
+    }
+
+    /* Bind the arguments given with -D */
+    if (!defines.empty()) {
+        map<symbol::Argument *, ConstantData *> bindings;
+        auto &args = context->data->arguments;
+
+        for (auto &d : defines) {
+            auto it = find_if(args.begin(), args.end(),
+                              [&](symbol::Argument *a) {
+                                  return a->get_name() == d.first;
+                              });
+
+            if (it == args.end()) {
+                error() << "-D " << d.first << ": no argument named '"
+                        << d.first << "'\n";
+                return 1;
+            }
+
+            ConstantData *c = parse_binding(*it, d.second);
+            if (c == nullptr)
+                return 1;
+            bindings[*it] = c;
+        }
+
+        optimizer::bind_arguments(context->data, bindings);
+    }
+
+    /* Optimize the syntax trees */
+    auto files = context->parsed_files();
+    if (tgp)
+        passes.run(context->data, files, parse_tgl);
+    else
+        passes.run(context->data);
+
+    /* Print the intermediate representation */
+    if (print_ir) {
+        ir::Function *f = ir::lower(context->data->body);
+        f->print(cerr);
+        delete f;
+
+        if (tgp) {
+            for (auto it = files.begin(); it != files.end(); ++it) {
+                cerr << "\n" << it->first << ":\n";
+                f = ir::lower(it->second->body);
+                f->print(cerr);
+                delete f;
+            }
+        }
+    }
+
     try {
         if (!use_stdout || exec_directly) {
             if (outpath.empty())
@@ -222,7 +401,7 @@ int main(int argc, char **argv)
             }
 
             if (tgp)
-                generate_tgp(f, backend, context->data, context->parsed_files());
+                generate_tgp(f, backend, context->data, files);
             else
                 generate_tgl(f, backend, context->data);
             f.close();
@@ -239,7 +418,7 @@ int main(int argc, char **argv)
         } else {
             /* Output to stdout */
             if (tgp)
-                generate_tgp(cout, backend, context->data, context->parsed_files());
+                generate_tgp(cout, backend, context->data, files);
             else
                 generate_tgl(cout, backend, context->data);
         }
@@ -0,0 +1,240 @@
+#include <set>
+#include <sstream>
+
+#include "memo.hpp"
+#include "optimizer.hpp"
+
+namespace memo {
+
+    using namespace ast;
+    using ast_rewriter::AST_Rewriter;
+
+    /** Collects the variables that are declared by statements and loops */
+    class DeclarationCollector : public AST_Rewriter
+    {
+        public:
+            DeclarationCollector()
+                : AST_Rewriter(nullptr), declared() {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(ForEach *p) {
+                declared.insert(p->variable());
+                declared.insert(p->loop_variable());
+                AST_Rewriter::visit(p);
+            }
+
+            virtual void visit(ForEachEnum *p) {
+                declared.insert(p->index());
+                declared.insert(p->value());
+                AST_Rewriter::visit(p);
+            }
+
+            virtual void visit(VariableDeclaration *p) {
+                declared.insert(p->variable());
+                AST_Rewriter::visit(p);
+            }
+
+            set<symbol::Symbol *> declared;
+    };
+
+    static set<symbol::Symbol *> declarations(Statements *s)
+    {
+        DeclarationCollector c;
+
+        if (s)
+            s->accept(c);
+        return c.declared;
+    }
+
+    /** Walks the body and checks the memo blocks */
+    class MemoChecker : public AST_Rewriter
+    {
+        public:
+            MemoChecker()
+                : AST_Rewriter(nullptr), variant_(), frames_(), line_(0) {}
+
+            using AST_Rewriter::visit;
+
+            virtual Statement *rewrite_statement(Statement *s) {
+                int saved = line_;
+
+                if (s->line() != 0)
+                    line_ = s->line();
+                AST_Rewriter::rewrite_statement(s);
+                line_ = saved;
+                return s;
+            }
+
+            virtual Expression *rewrite(Expression *e) {
+                if (frames_.empty())
+                    return AST_Rewriter::rewrite(e);
+
+                /* The body may use the key expression itself */
+                string key = optimizer::structural_key(e);
+                vector<Frame *> keyed;
+
+                for (auto &f : frames_) {
+                    if (!f.keyed && f.key == key) {
+                        f.keyed = true;
+                        keyed.push_back(&f);
+                    }
+                }
+                AST_Rewriter::rewrite(e);
+                for (auto f : keyed)
+                    f->keyed = false;
+                return e;
+            }
+
+            virtual void visit(ForEach *p) {
+                p->set_expression(rewrite(p->expression()));
+                scope(p, { p->variable(), p->loop_variable() });
+            }
+
+            virtual void visit(ForEachEnum *p) {
+                p->set_expression(rewrite(p->expression()));
+                scope(p, { p->index(), p->value() });
+            }
+
+            virtual void visit(Macro *p) {
+                scope(p, vector<symbol::Symbol *>(p->params().begin(),
+                                                  p->params().end()));
+            }
+
+            virtual void visit(Memo *p);
+            virtual void visit(SymbolRef *p);
+            virtual void visit(VariableAssignment *p);
+            virtual void visit(Create *p);
+        private:
+            MemoChecker(const MemoChecker &) = delete;
+            MemoChecker &operator=(const MemoChecker &) = delete;
+
+            /** The memo blocks that are being visited */
+            struct Frame
+            {
+                Memo *memo;
+                string key;
+                /* The variables that may change between the evaluations
+                 * of the block, and the ones declared in it */
+                set<symbol::Symbol *> variant;
+                set<symbol::Symbol *> local;
+                /* Set while the key expression is visited */
+                bool keyed;
+            };
+
+            /** Visits the statements of a scope that may be run more than
+             * once, where the variables may change between the runs */
+            void scope(Scope *, const vector<symbol::Symbol *> &);
+
+            void error(Frame &, const string &);
+
+            set<symbol::Symbol *> variant_;
+            vector<Frame> frames_;
+            int line_;
+    };
+
+    void MemoChecker::scope(Scope *p,
+                            const vector<symbol::Symbol *> &variables)
+    {
+        if (!p->statements())
+            return;
+
+        auto saved = variant_;
+        auto declared = declarations(p->statements());
+        auto assigned = optimizer::assigned_variables(p->statements());
+
+        variant_.insert(variables.begin(), variables.end());
+        variant_.insert(declared.begin(), declared.end());
+        variant_.insert(assigned.begin(), assigned.end());
+
+        p->set_statements(rewrite_block(p->statements()));
+        variant_ = saved;
+    }
+
+    void MemoChecker::error(Frame &f, const string &s)
+    {
+        stringstream ss;
+
+        ss << s << " (in the memo block on line " << f.memo->line() << ")";
+        throw MemoError(line_ ? line_ : f.memo->line(), ss.str());
+    }
+
+    void MemoChecker::visit(Memo *p)
+    {
+        p->set_key(rewrite(p->key()));
+
+        if (!p->statements())
+            return;
+
+        frames_.push_back({ p, optimizer::structural_key(p->key()), variant_,
+                            declarations(p->statements()), false });
+        p->set_statements(rewrite_block(p->statements()));
+        frames_.pop_back();
+    }
+
+    void MemoChecker::visit(SymbolRef *p)
+    {
+        auto s = p->symbol();
+
+        for (auto &f : frames_) {
+            if (!f.keyed && f.variant.count(s) && !f.local.count(s))
+                error(f, "the block depends on '" + s->get_name() + "', "
+                      "which may change between the evaluations of the "
+                      "block (only the key and values that don't change "
+                      "can be used)");
+        }
+    }
+
+    void MemoChecker::visit(VariableAssignment *p)
+    {
+        AST_Rewriter::visit(p);
+
+        for (auto &f : frames_) {
+            if (!f.local.count(p->variable()))
+                error(f, "'" + p->variable()->get_name() + "' is declared "
+                      "outside of the block and can't be assigned in it");
+        }
+    }
+
+    void MemoChecker::visit(Create *p)
+    {
+        AST_Rewriter::visit(p);
+
+        if (!frames_.empty())
+            error(frames_.back(), "create() can't be used in a memo block");
+    }
+
+    void check(Statements *body)
+    {
+        MemoChecker c;
+
+        if (body)
+            c.rewrite_block(body);
+    }
+
+    /** Collects the memo blocks */
+    class MemoCollector : public AST_Rewriter
+    {
+        public:
+            MemoCollector()
+                : AST_Rewriter(nullptr), memos() {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(Memo *p) {
+                memos.push_back(p);
+                AST_Rewriter::visit(p);
+            }
+
+            vector<Memo *> memos;
+    };
+
+    vector<Memo *> memos(Statements *body)
+    {
+        MemoCollector c;
+
+        if (body)
+            c.rewrite_block(body);
+        return c.memos;
+    }
+}
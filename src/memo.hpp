@@ -0,0 +1,44 @@
+#ifndef __MEMO_H__
+#define __MEMO_H__
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "ast.hpp"
+
+namespace memo {
+
+    /** Thrown when the body of a memo block depends on something else than
+     * its key and values that can't change between its evaluations */
+    class MemoError : public runtime_error
+    {
+        public:
+            MemoError(int line, const string &s)
+                : runtime_error(s), line_(line) {}
+
+            /** Returns the line of the statement that caused the error */
+            int line() const {
+                return line_;
+            }
+        private:
+            int line_;
+    };
+
+    /** Checks that the body of every memo block in the statements only
+     * depends on the key of the block, on the arguments, and on variables
+     * that are not changed by any enclosing loop (or macro call). The body
+     * may not assign variables declared outside of it or create files,
+     * since that wouldn't be done when the cached text is written.
+     *
+     * @throw MemoError
+     */
+    void check(ast::Statements *);
+
+    /** Returns the memo blocks in the statements, in order */
+    vector<ast::Memo *> memos(ast::Statements *);
+}
+
+#endif
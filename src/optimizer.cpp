@@ -0,0 +1,507 @@
+#include <iomanip>
+#include <sstream>
+
+#include "ast_printer.hpp"
+#include "optimizer.hpp"
+#include "accumulate.hpp"
+#include "concat.hpp"
+#include "cse.hpp"
+#include "dispatch.hpp"
+#include "fold.hpp"
+#include "fusion.hpp"
+#include "licm.hpp"
+#include "render.hpp"
+#include "sink.hpp"
+#include "specialize.hpp"
+
+namespace optimizer {
+
+    /** Collects the symbols referenced by an expression */
+    class SymbolCollector : public AST_Rewriter
+    {
+        public:
+            SymbolCollector()
+                : AST_Rewriter(nullptr), referenced(), bound() {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(SymbolRef *p) {
+                referenced.insert(p->symbol());
+            }
+
+            virtual void visit(LambdaExpression *p) {
+                for (auto v = p->variables; v != nullptr; v = v->next)
+                    bound.insert(v->statement->variable());
+                AST_Rewriter::visit(p);
+            }
+
+            set<symbol::Symbol *> referenced;
+            set<symbol::Symbol *> bound;
+    };
+
+    /** Collects the variables that are assigned by statements */
+    class AssignmentCollector : public AST_Rewriter
+    {
+        public:
+            AssignmentCollector()
+                : AST_Rewriter(nullptr), assigned() {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(VariableAssignment *p) {
+                assigned.insert(p->variable());
+            }
+
+            set<symbol::Symbol *> assigned;
+    };
+
+    /** Collects the usage of a record variable */
+    class RecordUsageCollector : public AST_Rewriter
+    {
+        public:
+            RecordUsageCollector(symbol::Symbol *s)
+                : AST_Rewriter(nullptr), usage(), symbol_(s) {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(SymbolRef *p) {
+                if (p->symbol() == symbol_)
+                    usage.whole = true;
+            }
+
+            virtual void visit(FieldRef *p) {
+                SymbolRef *r = p->record()->symbol_ref();
+
+                if (r && r->symbol() == symbol_)
+                    usage.fields.insert(p->field());
+                else
+                    AST_Rewriter::visit(p);
+            }
+
+            RecordUsage usage;
+        private:
+            RecordUsageCollector(const RecordUsageCollector &) = delete;
+            RecordUsageCollector &operator=(
+                const RecordUsageCollector &) = delete;
+
+            symbol::Symbol *symbol_;
+    };
+
+    /** Finds method calls that may raise errors in the generated script */
+    class SpeculationChecker : public AST_Rewriter
+    {
+        public:
+            SpeculationChecker()
+                : AST_Rewriter(nullptr), safe(true) {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(MethodCall *p) {
+                auto t = p->expression()->type();
+                auto name = p->method().name();
+
+                if (name == "wrap")
+                    safe = false;
+                else if (name == "get" && t->dict())
+                    safe = false;
+                else if ((name == "sort" || name == "sort_by") &&
+                         t->list()->elem()->record())
+                    safe = false;
+                AST_Rewriter::visit(p);
+            }
+
+            virtual void visit(Pipeline *p) {
+                /* Records are sorted by a field name given as a string (the
+                 * sort takes two arguments) */
+                if (p->sort() && p->sort()->next)
+                    safe = false;
+                AST_Rewriter::visit(p);
+            }
+
+            bool safe;
+    };
+
+    /** Builds the structural key of an expression */
+    class KeyBuilder : public AST_Rewriter
+    {
+        public:
+            KeyBuilder()
+                : AST_Rewriter(nullptr), key(), bound_() {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(TernaryIf *p) {
+                key << "?(";
+                p->condition()->accept(*this);
+                key << ",";
+                p->if_true()->accept(*this);
+                key << ",";
+                p->if_false()->accept(*this);
+                key << ")";
+            }
+            virtual void visit(And *p) {
+                binary("and", p);
+            }
+            virtual void visit(Or *p) {
+                binary("or", p);
+            }
+            virtual void visit(Not *p) {
+                key << "not(";
+                p->expression()->accept(*this);
+                key << ")";
+            }
+            virtual void visit(BoolEquals *p) {
+                binary("b==", p);
+            }
+            virtual void visit(LessThan *p) {
+                binary("<", p);
+            }
+            virtual void visit(LessThanOrEqual *p) {
+                binary("<=", p);
+            }
+            virtual void visit(GreaterThan *p) {
+                binary(">", p);
+            }
+            virtual void visit(GreaterThanOrEqual *p) {
+                binary(">=", p);
+            }
+            virtual void visit(Equals *p) {
+                binary("==", p);
+            }
+            virtual void visit(Plus *p) {
+                binary("+", p);
+            }
+            virtual void visit(Minus *p) {
+                binary("-", p);
+            }
+            virtual void visit(Times *p) {
+                binary("*", p);
+            }
+            virtual void visit(StringLessThan *p) {
+                binary("s<", p);
+            }
+            virtual void visit(StringLessThanOrEqual *p) {
+                binary("s<=", p);
+            }
+            virtual void visit(StringGreaterThan *p) {
+                binary("s>", p);
+            }
+            virtual void visit(StringGreaterThanOrEqual *p) {
+                binary("s>=", p);
+            }
+            virtual void visit(StringEquals *p) {
+                binary("s==", p);
+            }
+            virtual void visit(StringRepeat *p) {
+                binary("s*", p);
+            }
+            virtual void visit(StringConcat *p) {
+                binary("s+", p);
+            }
+            virtual void visit(ListConcat *p) {
+                binary("l+", p);
+            }
+            virtual void visit(Constant *p) {
+                key << "c:" << p->type()->str() << ":";
+                p->data()->print(key);
+            }
+            virtual void visit(MethodCall *p) {
+                key << "." << p->method().name() << "(";
+                p->expression()->accept(*this);
+                list(p->arguments());
+                key << ")";
+            }
+            virtual void visit(SymbolRef *p) {
+                auto it = bound_.find(p->symbol());
+
+                if (it != bound_.end())
+                    key << "$" << it->second;
+                else
+                    key << "s:" << p->symbol();
+            }
+            virtual void visit(FieldRef *p) {
+                key << "f:" << p->field() << "(";
+                p->record()->accept(*this);
+                key << ")";
+            }
+            virtual void visit(List *p) {
+                key << "[" << p->type()->str();
+                list(p->elements());
+                key << "]";
+            }
+            virtual void visit(Record *p) {
+                key << "{" << p->type()->str();
+                list(p->fields());
+                key << "}";
+            }
+            virtual void visit(Pipeline *p) {
+                key << "|(";
+                p->source()->accept(*this);
+                for (auto &s : p->stages()) {
+                    key << (s.kind == Pipeline::MAP ? ",map" : ",filter");
+                    s.lambda->accept(*this);
+                }
+                key << ",sort";
+                list(p->sort());
+                key << "," << p->reduce();
+                list(p->reduce_arguments());
+                key << ")";
+            }
+            virtual void visit(StringJoin *p) {
+                key << "s+(";
+                list(p->parts());
+                key << ")";
+            }
+            virtual void visit(Dict *p) {
+                key << "{" << p->type()->str();
+                list(p->keys());
+                key << ":";
+                list(p->values());
+                key << "}";
+            }
+            virtual void visit(LambdaExpression *p) {
+                key << "^(";
+                for (auto v = p->variables; v != nullptr; v = v->next) {
+                    size_t n = bound_.size();
+                    bound_[v->statement->variable()] = n;
+                    key << v->statement->variable()->get_type()->str() << ",";
+                }
+                p->expression->accept(*this);
+                key << ")";
+            }
+            virtual void visit(FunctionCall *p) {
+                key << p->name << "(";
+                for (auto a = p->args; a != nullptr; a = a->next) {
+                    key << ",";
+                    a->arg->accept(*this);
+                }
+                key << ")";
+            }
+            virtual void visit(FuncArgExpression *p) {
+                p->value->accept(*this);
+            }
+            virtual void visit(FuncArgLambda *p) {
+                p->value->accept(*this);
+            }
+
+            stringstream key;
+        private:
+            void binary(const char *s, BinaryExpression *p) {
+                key << s << "(";
+                p->lhs()->accept(*this);
+                key << ",";
+                p->rhs()->accept(*this);
+                key << ")";
+            }
+
+            void list(ExpressionList *l) {
+                for (auto e = l; e != nullptr; e = e->next) {
+                    key << ",";
+                    e->expression->accept(*this);
+                }
+            }
+
+            map<symbol::Symbol *, size_t> bound_;
+    };
+
+    bool is_trivial(Expression *e)
+    {
+        if (e->constant() || e->symbol_ref())
+            return true;
+        else if (e->field_ref())
+            return is_trivial(e->field_ref()->record());
+        return false;
+    }
+
+    bool is_speculatable(Expression *e)
+    {
+        SpeculationChecker c;
+        e->accept(c);
+        return c.safe;
+    }
+
+    set<symbol::Symbol *> free_symbols(Expression *e)
+    {
+        SymbolCollector c;
+        set<symbol::Symbol *> free;
+
+        e->accept(c);
+        for (auto s : c.referenced) {
+            if (c.bound.find(s) == c.bound.end())
+                free.insert(s);
+        }
+        return free;
+    }
+
+    string structural_key(Expression *e)
+    {
+        KeyBuilder b;
+        e->accept(b);
+        return b.key.str();
+    }
+
+    RecordUsage record_usage(Statements *s, symbol::Symbol *r)
+    {
+        RecordUsageCollector c(r);
+
+        if (s)
+            s->accept(c);
+        return c.usage;
+    }
+
+    set<symbol::Symbol *> assigned_variables(Statements *s)
+    {
+        AssignmentCollector c;
+
+        if (s)
+            s->accept(c);
+        return c.assigned;
+    }
+
+    symbol::Variable *create_temporary(symbol::SymbolTable *t,
+                                       const Type *type,
+                                       const string &prefix)
+    {
+        static unsigned count = 0;
+        stringstream ss;
+
+        ss << "__" << prefix << count++;
+        auto v = symbol::Variable::create(ss.str(), type, true, true);
+        t->add(v);
+        return v;
+    }
+
+    template<typename T>
+    AST_Rewriter *create_pass(symbol::SymbolTable *t)
+    {
+        return new T(t);
+    }
+
+    /** The available passes, in the order they are run. Passes without a
+     * factory work on whole .tgp files, and are run by
+     * PassManager::run(tgp, tgl, parse) */
+    static const struct {
+        const char *name;
+        const char *description;
+        unsigned level;
+        AST_Rewriter *(*create)(symbol::SymbolTable *);
+    } passes[] = {
+        { "specialize", "specialize .tgl files for the constant arguments "
+            "of each create()", 2, nullptr },
+        { "fold", "fold constant expressions and remove dead branches",
+            1, create_pass<ConstantFolding> },
+        { "prerender", "render files that don't depend on arguments at "
+            "compile time", 1, create_pass<StaticRendering> },
+        { "fusion", "fuse map()/filter() chains into single-pass pipelines",
+            1, create_pass<PipelineFusion> },
+        { "sink", "drop unused with-bindings and move the ones used in a "
+            "single branch into it", 2, create_pass<BindingSinking> },
+        { "licm", "hoist loop-invariant expressions out of for loops",
+            2, create_pass<LoopInvariantCodeMotion> },
+        { "cse", "eliminate common subexpressions within a block",
+            2, create_pass<CommonSubexpressionElimination> },
+        { "concat", "flatten string concatenations into single joins",
+            1, create_pass<ConcatFlattening> },
+        { "accumulate", "append to strings and lists built up in loops in "
+            "place", 1, create_pass<InPlaceAccumulation> },
+        { "dispatch", "select the branch of if/elif chains over constants "
+            "with a table lookup", 2, create_pass<TableDispatch> }
+    };
+
+    static const size_t num_passes = sizeof(passes) / sizeof(passes[0]);
+
+    static bool known_pass(const string &name)
+    {
+        for (size_t i = 0; i < num_passes; i++) {
+            if (name == passes[i].name)
+                return true;
+        }
+        return false;
+    }
+
+    void PassManager::set_enabled(const string &pass, bool enabled)
+    {
+        if (!known_pass(pass))
+            throw UnknownPass("unknown optimization pass '" + pass + "'");
+        enabled_[pass] = enabled;
+    }
+
+    void PassManager::set_dump_after(const string &pass)
+    {
+        if (!known_pass(pass))
+            throw UnknownPass("unknown optimization pass '" + pass + "'");
+        dump_after_.insert(pass);
+    }
+
+    bool PassManager::enabled(size_t i) const
+    {
+        auto it = enabled_.find(passes[i].name);
+
+        if (it != enabled_.end())
+            return it->second;
+        return level_ >= passes[i].level;
+    }
+
+    bool PassManager::enabled(const string &name) const
+    {
+        for (size_t i = 0; i < num_passes; i++) {
+            if (name == passes[i].name)
+                return enabled(i);
+        }
+        return false;
+    }
+
+    void PassManager::run(ParseData *data) const
+    {
+        for (size_t i = 0; i < num_passes; i++) {
+            if (passes[i].create == nullptr)
+                continue;
+
+            if (data->body && enabled(i)) {
+                AST_Rewriter *pass = passes[i].create(data->root_table);
+                data->body = pass->rewrite_block(data->body);
+                delete pass;
+            }
+            dump(passes[i].name, data);
+        }
+    }
+
+    void PassManager::run(ParseData *tgp, map<string, ParseData *> &tgl,
+                          ParseData *(*parse)(const string &)) const
+    {
+        /* The keyword arguments are folded before the files are
+         * specialized, and the copies are optimized with the other files */
+        run(tgp);
+        if (enabled("specialize")) {
+            specialize_creates(tgp, tgl, parse);
+            dump("specialize", tgp);
+        }
+        for (auto it = tgl.begin(); it != tgl.end(); ++it)
+            run(it->second);
+
+        /* The files created with constant arguments can be rendered now that
+         * the .tgl files are optimized */
+        if (enabled("prerender"))
+            render_creates(tgp, tgl);
+    }
+
+    void PassManager::dump(const string &pass, ParseData *data) const
+    {
+        if (dump_after_.count(pass)) {
+            ast_printer::AST_Printer p;
+
+            cerr << "AST after " << pass << ":\n";
+            if (data->body)
+                data->body->accept(p);
+        }
+    }
+
+    void PassManager::print_passes(ostream &os)
+    {
+        for (size_t i = 0; i < num_passes; i++) {
+            os << " " << setw(20) << left << passes[i].name
+               << passes[i].description << " (-O" << passes[i].level
+               << ")\n";
+        }
+    }
+}
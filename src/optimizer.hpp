@@ -0,0 +1,125 @@
+#ifndef __OPTIMIZER_H__
+#define __OPTIMIZER_H__
+
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "ast.hpp"
+#include "ast_rewriter.hpp"
+#include "data.hpp"
+#include "symbol.hpp"
+
+namespace optimizer {
+
+    using namespace ast;
+    using ast_rewriter::AST_Rewriter;
+
+    /** Returns true if the expression is a constant, a symbol reference or a
+     * field of such (i.e. something that is as cheap to evaluate as a
+     * reference to a temporary) */
+    bool is_trivial(Expression *);
+
+    /** Returns true if the expression can be evaluated in a place where the
+     * template didn't evaluate it, without raising errors in the generated
+     * script (e.g. a wrap() with a negative width) */
+    bool is_speculatable(Expression *);
+
+    /** Returns the symbols referenced by the expression, excluding the
+     * variables bound by lambdas in the expression itself */
+    set<symbol::Symbol *> free_symbols(Expression *);
+
+    /** Returns a string that is equal for structurally identical
+     * expressions. Symbols are compared by identity, except for the
+     * variables bound by lambdas in the expression */
+    string structural_key(Expression *);
+
+    /** RecordUsage struct
+     *
+     * Describes how a record variable is used: which of its fields are read,
+     * and whether the record itself is used as a value (e.g. assigned to
+     * another variable).
+     */
+    struct RecordUsage
+    {
+        RecordUsage()
+            : whole(false), fields() {}
+
+        bool used() const {
+            return whole || !fields.empty();
+        }
+        bool uses(const string &f) const {
+            return whole || fields.count(f);
+        }
+
+        bool whole;
+        set<string> fields;
+    };
+
+    /** Returns the usage of a record variable in the statements */
+    RecordUsage record_usage(Statements *, symbol::Symbol *);
+
+    /** Returns the variables assigned anywhere in the statements */
+    set<symbol::Symbol *> assigned_variables(Statements *);
+
+    /** Creates a compiler generated variable and adds it to the table */
+    symbol::Variable *create_temporary(symbol::SymbolTable *, const Type *,
+                                       const string &prefix);
+
+    class UnknownPass : public runtime_error
+    {
+        public:
+            UnknownPass(const string &s)
+                : runtime_error(s) {}
+    };
+
+    /** PassManager class
+     *
+     * Runs the optimization passes, in a fixed order, on the parsed files.
+     * Which passes that are run is decided by the optimization level
+     * (-O0, -O1, -O2), where each pass is enabled from a certain level, and
+     * by the passes explicitly enabled or disabled (-f<pass>, -fno-<pass>).
+     */
+    class PassManager
+    {
+        public:
+            PassManager()
+                : level_(2), enabled_(), dump_after_() {}
+
+            void set_level(unsigned level) {
+                level_ = level;
+            }
+
+            /** Enables or disables a pass regardless of the level */
+            void set_enabled(const string &pass, bool enabled);
+
+            /** Prints the syntax tree after the pass has been run */
+            void set_dump_after(const string &pass);
+
+            /** Runs the enabled passes on a parsed file */
+            void run(ParseData *) const;
+
+            /** Runs the enabled passes on a parsed .tgp file and the .tgl
+             * files it creates. Specialized copies of the .tgl files are
+             * parsed with the given function and added to the files */
+            void run(ParseData *, map<string, ParseData *> &,
+                     ParseData *(*parse)(const string &)) const;
+
+            /** Prints the available passes */
+            static void print_passes(ostream &);
+        private:
+            bool enabled(size_t) const;
+            bool enabled(const string &) const;
+            void dump(const string &, ParseData *) const;
+
+            unsigned level_;
+            map<string, bool> enabled_;
+            set<string> dump_after_;
+    };
+}
+
+#endif
@@ -9,17 +9,19 @@
 #include "ast_printer.hpp"
 #include "common.hpp"
 #include "data.hpp"
+#include "memo.hpp"
 #include "symbol.hpp"
 
 using namespace constant;
 using namespace symbol;
 
-/* constant_list is used by the constant_list grammar rule to hold the list
-  elements. This is used instead of a AST approach and is ok since only one
-  list will be handled at a time (since a list can only contain primitives and
-  records) same reasoning for constant_record */
-std::vector<SingleConstantData *> constant_list;
-std::vector<PrimitiveConstantData *> constant_record;
+/* constant_dict and constant_set are used by the constant_dict and
+  constant_set grammar rules to hold the elements. This is used instead of a
+  AST approach and is ok since only one dict or set will be handled at a time
+  (since they can't be nested in constants). Lists and records can be nested
+  in each other, so their elements are held by the semantic values */
+std::vector<DictConstantData::entry> constant_dict;
+std::vector<PrimitiveConstantData *> constant_set;
 
 /* same reasoning as above */
 std::vector<Param *> param_list;
@@ -28,6 +30,18 @@ RecordType::field_vector record_members;
 
 std::map<string, ast::Expression *> kw_map;
 
+/* the parameters of the macro that is being defined */
+std::vector<Variable *> macro_params;
+
+/* A macro call is parsed as a function call, which holds the call in
+  pending_macro_call and returns pending_macro_marker in place of it. The
+  call is taken over by the inlined expression or call statement that has the
+  marker as its whole expression, any other use of it is an error */
+ast::MacroCall *pending_macro_call = nullptr;
+ast::Expression *pending_macro_marker = nullptr;
+
+/* Returns the record held by an argument type (directly, or as the elements
+ * of a list or the values of a dictionary), if any */
 #define scanner context->scanner
 %}
 
@@ -57,11 +71,17 @@ std::map<string, ast::Expression *> kw_map;
     const Type *type;
     const SingleType *stype;
     const ListType *ltype;
+    const DictType *dtype;
+    const SetType *settype;
     ConstantData *constant;
     SingleConstantData *single_const;
     PrimitiveConstantData *primitive_const;
     RecordConstantData *record_const;
     ListConstantData *list_const;
+    DictConstantData *dict_const;
+    SetConstantData *set_const;
+    std::vector<ConstantData *> *const_values;
+    std::vector<SingleConstantData *> *single_const_values;
     Argument *argument;
     Param *param;
 
@@ -70,12 +90,14 @@ std::map<string, ast::Expression *> kw_map;
     ast::Expression *expression;
 
     ast::Scope *scope;
+    ast::Macro *macro;
     ast::If *if_node;
     ast::Elif *elif_node;
     ast::Else *else_node;
 
     ast::List *list;
     ast::Record *record;
+    ast::Dict *dict;
     ast::ExpressionList *expression_list;
     ast::VariableList *variable_list;
     ast::VariableStatement *variable_stmt;
@@ -91,6 +113,78 @@ void yyverror(YYLTYPE *, ParseContext *, const char *, ...);
 void yywarning(YYLTYPE *, ParseContext *, const char *);
 void yyvwarning(YYLTYPE *, ParseContext *, const char *, ...);
 
+/* Reports an error if a macro call is pending, i.e. if a macro has been
+ * called in a part of an expression */
+static bool stray_macro_call(YYLTYPE *l, ParseContext *context)
+{
+    if (!pending_macro_call)
+        return false;
+
+    yyerror(l, context, "a macro can only be called as the whole expression "
+            "of {{ }} or with % call");
+    pending_macro_call = nullptr;
+    return true;
+}
+
+/* Reports an error unless a break or continue (the statement) is in a loop
+ * of the current block, i.e. not outside of the loops of a memo block */
+static bool in_loop(YYLTYPE *l, ParseContext *context, const char *statement)
+{
+    auto &depths = context->data->loop_depths;
+
+    if (depths.back() > 0)
+        return true;
+
+    if (any_of(depths.begin(), depths.end(), [](unsigned d) { return d > 0; }))
+        yyverror(l, context, "%s can't leave a memo block", statement);
+    else
+        yyverror(l, context, "%s outside of a loop", statement);
+    return false;
+}
+
+/* Checks the arguments of a call to the macro and makes the call pending.
+ * Returns the marker of the call, or nullptr on errors */
+static ast::Expression *macro_call(YYLTYPE *l, ParseContext *context,
+    ast::Macro *m, ast::FuncArgList *args)
+{
+    auto &params = m->params();
+    ast::ExpressionList *list = nullptr, **tail = &list;
+    size_t n = 0;
+
+    if (stray_macro_call(l, context))
+        return nullptr;
+
+    for (auto a = args; a != nullptr; a = a->next, n++) {
+        if (!a->arg->expression()) {
+            yyerror(l, context, "a macro can't take a lambda expression as "
+                "argument");
+            return nullptr;
+        }
+
+        ast::Expression *e = a->arg->expression()->value;
+
+        if (n < params.size() && e->type() != params[n]->get_type()) {
+            yyverror(l, context, "wrong type for argument %d to macro '%s' "
+                "(got %s, expected %s)", (int)n + 1, m->name().c_str(),
+                e->type()->str().c_str(),
+                params[n]->get_type()->str().c_str());
+            return nullptr;
+        }
+        *tail = new ast::ExpressionList(e);
+        tail = &(*tail)->next;
+    }
+
+    if (n != params.size()) {
+        yyverror(l, context, "wrong number of arguments to macro '%s' (got "
+            "%d, expected %d)", m->name().c_str(), (int)n,
+            (int)params.size());
+        return nullptr;
+    }
+
+    pending_macro_call = new ast::MacroCall(m, list);
+    pending_macro_marker = new ast::Constant(new StringConstantData(""));
+    return pending_macro_marker;
+}
 %}
 
 %token END 0 "end of file"
@@ -103,6 +197,9 @@ void yyvwarning(YYLTYPE *, ParseContext *, const char *, ...);
 %token AND "and" OR "or" NOT "not"
 %token WITH "with"
 %token CREATE "create"
+%token MACRO "macro" ENDMACRO "endmacro" CALL "call"
+%token MEMO "memo" ENDMEMO "endmemo"
+%token BREAK "break" CONTINUE "continue"
 %token INCLUDE "include"
 %token L_INLINE "{{" R_INLINE "}}"
 %token LE "<=" EQ "==" NEQ "!=" GE ">="
@@ -113,12 +210,19 @@ void yyvwarning(YYLTYPE *, ParseContext *, const char *, ...);
 %token<string> STRING "string constant"
 
 %token<string> LIST
+%token<string> DICT
+%token<string> SET
 
 %type<constant> constant
 %type<single_const> single_constant
 %type<primitive_const> primitive_constant
 %type<record_const> record_constant
 %type<list_const> constant_list
+%type<dict_const> constant_dict
+%type<set_const> constant_set
+%type<constant> field_constant
+%type<const_values> record_values
+%type<single_const_values> constant_list_values
 
 %type<funcarg_list> function_args
 
@@ -126,15 +230,18 @@ void yyvwarning(YYLTYPE *, ParseContext *, const char *, ...);
 
 %type<param> param
 
-%type<type> type
+%type<type> type record_member_type
 %type<stype> single_type
 %type<ltype> list_type
+%type<dtype> dict_type
+%type<settype> set_type
 
 %type<statements> statements
 
 %type<statement> statement text conditional control inlined
-%type<statement> create
-%type<scope> loop for_each for_each_enum
+%type<statement> create call loop_exit
+%type<macro> macro macro_head macro_start
+%type<scope> loop for_each for_each_enum memo memo_start
 %type<if_node> if if_start
 %type<elif_node> elif_start elifs elif
 %type<else_node> else_start else
@@ -145,7 +252,8 @@ void yyvwarning(YYLTYPE *, ParseContext *, const char *, ...);
 %type<expression> expression condition function_call
 %type<list> list
 %type<record> record
-%type<expression_list> expression_list list_values
+%type<dict> dict
+%type<expression_list> expression_list list_values dict_values
 
 %type<lambda> lambda lambda_start
 
@@ -154,10 +262,11 @@ void yyvwarning(YYLTYPE *, ParseContext *, const char *, ...);
 %left AND
 %left EQ NEQ
 %left NOT
-%left '<' '>' LE GE
+%left '<' '>' LE GE IN
 %left '+' '-'
 %left '*'
 %left '.' '#'
+%left '['
 
 %start file
 
@@ -246,16 +355,8 @@ record_def_members
     ;
 
 record_member
-    : single_type IDENTIFIER ';'
+    : record_member_type IDENTIFIER ';'
     {
-        const PrimitiveType *p = $1 ? $1->primitive() : nullptr;
-
-        if (p == nullptr) {
-            yyverror(&@2, context,
-                "a record can only hold primitive types (got %s)", $1);
-            YYERROR;
-        }
-
         auto it = find_if(record_members.begin(), record_members.end(),
             [&] (const RecordField &r) { return r.name == $2; });
 
@@ -264,16 +365,31 @@ record_member
             YYERROR;
         }
 
-        record_members.push_back({ $2, p});
+        record_members.push_back({ $2, $1 });
 
         free($2);
     }
-    | list_type IDENTIFIER ';'
+    | set_type IDENTIFIER ';'
     {
     	yyverror(&@2, context,
-            "a record can only hold primitive types (got %s)", $1);
+            "a record can only hold primitives, records and lists (got %s)",
+            $1->str().c_str());
         YYERROR;
     }
+    | dict_type IDENTIFIER ';'
+    {
+    	yyverror(&@2, context,
+            "a record can only hold primitives, records and lists (got %s)",
+            $1->str().c_str());
+        YYERROR;
+    }
+
+/* Records can only hold records that are already defined, so they can't
+ * hold themselves */
+record_member_type
+    : single_type { $$ = $1; }
+    | list_type { $$ = $1; }
+    ;
 
 header_item_params
     : header_item_params_p { }
@@ -307,30 +423,37 @@ record_constant
         if (p == nullptr) {
             yyverror(&@1, context,
 	        "expected a record (got '%s')", t->str().c_str());
+            YYERROR;
         }
 
         $$ = new RecordConstantData(p);
 
         try {
-            $$->set(constant_record);
+            $$->set(*$3);
         } catch (const UnmatchingFieldSignature &e) {
             yyerror(&@1, context, e.what());
             YYERROR;
         }
 
-        constant_record.clear();
-
+        delete $3;
         free($1);
     }
 
 record_values
-    : record_values ',' primitive_constant { constant_record.push_back($3); }
-    | primitive_constant { constant_record.push_back($1); }
+    : record_values ',' field_constant { $$ = $1; $$->push_back($3); }
+    | field_constant { $$ = new std::vector<ConstantData *>(1, $1); }
+    ;
+
+field_constant
+    : single_constant { $$ = $1; }
+    | constant_list { $$ = $1; }
     ;
 
 type
     : single_type { $$ = $1; }
     | list_type { $$ = $1; }
+    | dict_type { $$ = $1; }
+    | set_type { $$ = $1; }
 
 single_type
     : IDENTIFIER
@@ -363,14 +486,124 @@ list_type
         free($1);
     }
 
+set_type
+    : SET
+    {
+        const Type *t = TypeFactory::get($1);
+
+        $$ = t ? t->set() : nullptr;
+
+        if ($$ == nullptr) {
+            yyverror(&@1, context,
+                "unknown type '%s' (a set can only hold primitives)", $1);
+            YYERROR;
+        }
+
+        free($1);
+    }
+
+constant_set
+    : '{' constant_set_values '}'
+    {
+        auto t = constant_set.front()->type()->primitive();
+        $$ = new SetConstantData(TypeFactory::get_set(t));
+
+        try {
+            for (PrimitiveConstantData *d : constant_set)
+                $$->add(d);
+        } catch (const DifferentTypesError &e) {
+            yyverror(&@1, context,
+	        "a set can only hold items of one type (%s)", e.what());
+            YYERROR;
+        }
+
+        constant_set.clear();
+    }
+    | set_type
+    {
+        $$ = new SetConstantData($1);
+    }
+    ;
+
+constant_set_values
+    : constant_set_values ',' primitive_constant { constant_set.push_back($3); }
+    | primitive_constant { constant_set.push_back($1); }
+    ;
+
+dict_type
+    : DICT
+    {
+        string s($1);
+        size_t sep = s.find("->");
+        string k = s.substr(0, sep);
+        string v = s.substr(sep + 2);
+        const Type *kt = TypeFactory::get(k);
+        const Type *vt = TypeFactory::get(v);
+
+        if (kt == nullptr) {
+            yyverror(&@1, context, "unknown type '%s'", k.c_str());
+            YYERROR;
+        } else if (vt == nullptr) {
+            yyverror(&@1, context, "unknown type '%s'", v.c_str());
+            YYERROR;
+        } else if (kt->primitive() == nullptr) {
+            yyverror(&@1, context,
+                "a dictionary key must be a primitive type (got %s)",
+                k.c_str());
+            YYERROR;
+        } else if (vt->single() == nullptr) {
+            yyverror(&@1, context,
+                "a dictionary can only hold primitives/records (got %s)",
+                v.c_str());
+            YYERROR;
+        }
+
+        $$ = TypeFactory::get_dict(kt->primitive(), vt->single());
+
+        free($1);
+    }
+
+constant_dict
+    : dict_type '{' constant_dict_values '}'
+    {
+        $$ = new DictConstantData($1);
+
+        try {
+            for (auto &e : constant_dict)
+                $$->add(e.first, e.second);
+        } catch (const DifferentTypesError &e) {
+            yyverror(&@1, context,
+	        "wrong type of dictionary entry (%s)", e.what());
+            YYERROR;
+        }
+
+        constant_dict.clear();
+    }
+    | dict_type
+    {
+        $$ = new DictConstantData($1);
+    }
+    ;
+
+constant_dict_values
+    : constant_dict_values ',' constant_dict_entry { }
+    | constant_dict_entry { }
+    ;
+
+constant_dict_entry
+    : primitive_constant ':' single_constant
+    {
+        constant_dict.push_back(make_pair($1, $3));
+    }
+    ;
+
 constant_list
     : '[' constant_list_values ']'
     {
-        $$ = new ListConstantData(TypeFactory::get_list(
-            constant_list.front()->type()));
+        $$ = new ListConstantData(TypeFactory::get_list($2->front()->type()));
 
         try {
-            for (SingleConstantData *d : constant_list)
+            for (SingleConstantData *d : *$2)
                 $$->add(d);
         } catch (const InvalidTypeError &e) {
             yyerror(&@1, context, e.what());
@@ -381,7 +614,7 @@ constant_list
             YYERROR;
         }
 
-        constant_list.clear();
+        delete $2;
     }
     | list_type
     {
@@ -390,8 +623,8 @@ constant_list
     ;
 
 constant_list_values
-    : constant_list_values ',' single_constant { constant_list.push_back($3); }
-    | single_constant { constant_list.push_back($1); }
+    : constant_list_values ',' single_constant { $$ = $1; $$->push_back($3); }
+    | single_constant { $$ = new std::vector<SingleConstantData *>(1, $1); }
     ;
 
 
@@ -406,6 +639,15 @@ body_block
     {
         context->data->body = $1;
         assert(context->data->current_table == context->data->root_table);
+
+        try {
+            memo::check($1);
+        } catch (const memo::MemoError &e) {
+            YYLTYPE l = @1;
+            l.first_line = l.last_line = e.line();
+            yyerror(&l, context, e.what());
+            YYERROR;
+        }
     }
     |
     ;
@@ -416,9 +658,9 @@ statements
     ;
 
 statement
-    : text { $$ = $1; }
-    | control { $$ = $1; }
-    | inlined { $$ = $1; }
+    : text { $$ = $1; $$->set_line(@1.first_line); }
+    | control { $$ = $1; $$->set_line(@1.first_line); }
+    | inlined { $$ = $1; $$->set_line(@1.first_line); }
     ;
 
 text
@@ -434,6 +676,10 @@ control
     | loop { $$ = $1; }
     | with { $$ = $1; }
     | create { $$ = $1; }
+    | macro { $$ = $1; }
+    | call { $$ = $1; }
+    | memo { $$ = $1; }
+    | loop_exit { $$ = $1; }
 
 conditional
     : if end_if
@@ -473,6 +719,7 @@ if_start
         context->data->current_table = new SymbolTable(context->data->current_table);
 
         $$ = new ast::If(nullptr, context->data->current_table);
+        $$->set_line(@1.first_line);
     }
 
 else
@@ -519,6 +766,7 @@ elif_start
     {
         context->data->current_table = new SymbolTable(context->data->current_table);
         $$ = new ast::Elif(nullptr, context->data->current_table);
+        $$->set_line(@1.first_line);
     }
 
 end_if
@@ -552,6 +800,9 @@ for_each
     {
         Variable *v;
 
+        if (stray_macro_call(&@4, context))
+            YYERROR;
+
         if ($4->type()->list() == nullptr) {
             yyverror(&@4, context,
                 "expected a list (got %s)", $4->type()->str().c_str());
@@ -575,6 +826,7 @@ for_each
 
         $$ = new ast::ForEach(v, $4, context->data->current_table->parent(),
             context->data->current_table);
+        context->data->loop_depths.back()++;
 
         /* Free the identifier string */
         free($2);
@@ -585,6 +837,9 @@ for_each_enum
     {
         Variable *i, *v;
 
+        if (stray_macro_call(&@6, context))
+            YYERROR;
+
         if ($6->type()->list() == nullptr) {
             yyverror(&@6, context,
 	    	"expected a list (got %s)", $6->type()->str().c_str());
@@ -616,6 +871,7 @@ for_each_enum
 
         $$ = new ast::ForEachEnum(i, v, $6, context->data->current_table->parent(),
             context->data->current_table);
+        context->data->loop_depths.back()++;
 
         /* Free the identifier string */
         free($2);
@@ -626,16 +882,26 @@ end_for
     {
         /* Go back to symbol table before the for loop */
         context->data->current_table = context->data->current_table->parent()->parent();
+        context->data->loop_depths.back()--;
     }
 
 with
-    : WITH variable_list { $$ = $2; }
+    : WITH variable_list
+    {
+        if (stray_macro_call(&@2, context))
+            YYERROR;
+        $$ = $2;
+    }
 
 create
     : CREATE '(' expression ',' STRING ',' BOOL create_keywords ')'
     {
         /* TODO: use absolute paths (realpath()) */
 
+        /* The call must not be left pending while the file is parsed */
+        if (stray_macro_call(&@3, context))
+            YYERROR;
+
         if (context->is_tgp()) {
             if ($3->type() != TypeFactory::get("string")) {
                 yyverror(&@3, context,
@@ -698,6 +964,154 @@ create_keywords
     : ',' keyword_list { /* empty */  }
     | /* empty */
 
+macro
+    : macro_start statements ENDMACRO
+    {
+        $$ = $1;
+        $$->set_statements($2);
+
+        /* Return to the top level, where the macro can be called from now
+         * on (i.e. a macro can't call itself) */
+        context->data->current_table = context->data->root_table;
+        context->data->macros[$$->name()] = $$;
+    }
+    | macro_start ENDMACRO
+    {
+        $$ = $1;
+        context->data->current_table = context->data->root_table;
+        context->data->macros[$$->name()] = $$;
+    }
+
+macro_start
+    : macro_head '(' macro_params ')'
+    {
+        $$ = $1;
+        $$->params() = macro_params;
+        macro_params.clear();
+
+        /* Enter the symbol table for the statements block */
+        context->data->current_table = $$->table();
+    }
+
+macro_head
+    : MACRO IDENTIFIER
+    {
+        if (context->data->current_table != context->data->root_table) {
+            yyerror(&@1, context, "a macro can only be defined at the top "
+                "level");
+            YYERROR;
+        }
+        if (context->data->macros.count($2)) {
+            yyverror(&@2, context, "macro '%s' is already defined", $2);
+            YYERROR;
+        }
+
+        /* The statements can only refer to the parameters and to the
+         * arguments, so the parameter table doesn't have the root table as
+         * its parent */
+        SymbolTable *t = new SymbolTable;
+
+        for (auto a : context->data->arguments)
+            t->add(a);
+        context->data->current_table = t;
+
+        $$ = new ast::Macro($2, t, new SymbolTable(t));
+        $$->set_line(@1.first_line);
+        free($2);
+    }
+
+macro_params
+    : macro_param_list { /* empty */ }
+    | /* empty */
+
+macro_param_list
+    : macro_param_list ',' macro_param { /* empty */ }
+    | macro_param { /* empty */ }
+
+macro_param
+    : type IDENTIFIER
+    {
+        try {
+            auto v = Variable::create($2, $1);
+
+            context->data->current_table->add(v);
+            macro_params.push_back(v);
+        } catch (const SymbolNameError &e) {
+            yyverror(&@2, context, e.what());
+            YYERROR;
+        } catch(const SymTabAlreadyDefinedError &e) {
+            stringstream sstr;
+            context->data->current_table->lookup($2)->print(sstr);
+            yyverror(&@2, context, "'%s' is already defined (as %s)\n",
+                $2, sstr.str().c_str());
+            YYERROR;
+        }
+        free($2);
+    }
+
+call
+    : CALL function_call
+    {
+        if (!pending_macro_call || $2 != pending_macro_marker) {
+            yyerror(&@2, context, "expected a macro call");
+            YYERROR;
+        }
+
+        $$ = pending_macro_call;
+        pending_macro_call = nullptr;
+        delete pending_macro_marker;
+    }
+
+memo
+    : memo_start statements ENDMEMO
+    {
+        $$ = $1;
+        $$->set_statements($2);
+
+        /* Return the the surrounding block's symbol table */
+        context->data->current_table = context->data->current_table->parent();
+        context->data->loop_depths.pop_back();
+    }
+    | memo_start ENDMEMO
+    {
+        $$ = $1;
+        context->data->current_table = context->data->current_table->parent();
+        context->data->loop_depths.pop_back();
+    }
+
+memo_start
+    : MEMO expression
+    {
+        if (stray_macro_call(&@2, context))
+            YYERROR;
+        if ($2->type()->primitive() == nullptr) {
+            yyverror(&@2, context, "the key of a memo must be a bool, int "
+                "or string (got %s)", $2->type()->str().c_str());
+            YYERROR;
+        }
+
+        /* Create symbol table for the statements block */
+        context->data->current_table = new SymbolTable(context->data->current_table);
+
+        $$ = new ast::Memo($2, context->data->current_table);
+        $$->set_line(@1.first_line);
+        context->data->loop_depths.push_back(0);
+    }
+
+loop_exit
+    : BREAK
+    {
+        if (!in_loop(&@1, context, "break"))
+            YYERROR;
+        $$ = new ast::Break;
+    }
+    | CONTINUE
+    {
+        if (!in_loop(&@1, context, "continue"))
+            YYERROR;
+        $$ = new ast::Continue;
+    }
+
 variable_list
     : variable_decl_assign ',' variable_list
     {
@@ -732,6 +1146,7 @@ variable_decl_assign
                 YYERROR;
             }
             $$ = new ast::VariableDeclaration(v, $4);
+            $$->set_line(@1.first_line);
         } catch (const SymbolNameError &e) {
             yyverror(&@2, context, e.what());
             YYERROR;
@@ -764,6 +1179,7 @@ variable_assign
                 YYERROR;
             }
             $$ = new ast::VariableAssignment(s->variable(), $3);
+            $$->set_line(@1.first_line);
         } catch (const SymTabNoSuchSymbolError &e) {
             yyverror(&@1, context, "no such variable: %s\n", e.what());
             YYERROR;
@@ -774,12 +1190,21 @@ variable_assign
 inlined
     : L_INLINE expression R_INLINE
     {
-        try {
-            $$ = new ast::InlinedExpression(
-                ast_factory::StringFactory::create($2));
-        } catch (const InvalidTypeError &e) {
-            yyverror(&@2, context, e.what());
+        if (pending_macro_call && $2 == pending_macro_marker) {
+            /* The output of the macro is written in place of the call */
+            $$ = pending_macro_call;
+            pending_macro_call = nullptr;
+            delete pending_macro_marker;
+        } else if (stray_macro_call(&@2, context)) {
             YYERROR;
+        } else {
+            try {
+                $$ = new ast::InlinedExpression(
+                    ast_factory::StringFactory::create($2));
+            } catch (const InvalidTypeError &e) {
+                yyverror(&@2, context, e.what());
+                YYERROR;
+            }
         }
     }
     ;
@@ -914,6 +1339,68 @@ expression
     {
         $$ = $1;
     }
+    | dict
+    {
+        $$ = $1;
+    }
+    | set_type
+    {
+        $$ = new ast::Constant(new SetConstantData($1));
+    }
+    | expression IN expression
+    {
+        try {
+            $$ = ast_factory::InFactory::create($1, $3);
+        } catch (const InvalidTypeError &e) {
+            yyverror(&@2, context, e.what());
+            YYERROR;
+        }
+    }
+    | expression NOT IN expression %prec IN
+    {
+        try {
+            $$ = new ast::Not(ast_factory::InFactory::create($1, $4));
+        } catch (const InvalidTypeError &e) {
+            yyverror(&@2, context, e.what());
+            YYERROR;
+        }
+    }
+    | expression '[' expression ']'
+    {
+        try {
+            $$ = ast_factory::IndexFactory::create($1, $3);
+        } catch (const InvalidTypeError &e) {
+            yyverror(&@2, context, e.what());
+            YYERROR;
+        }
+    }
+    | expression '[' expression ':' expression ']'
+    {
+        try {
+            $$ = ast_factory::IndexFactory::create($1, $3, $5);
+        } catch (const InvalidTypeError &e) {
+            yyverror(&@2, context, e.what());
+            YYERROR;
+        }
+    }
+    | expression '[' expression ':' ']'
+    {
+        try {
+            $$ = ast_factory::IndexFactory::create($1, $3, nullptr);
+        } catch (const InvalidTypeError &e) {
+            yyverror(&@2, context, e.what());
+            YYERROR;
+        }
+    }
+    | expression '[' ':' expression ']'
+    {
+        try {
+            $$ = ast_factory::IndexFactory::create($1, nullptr, $4);
+        } catch (const InvalidTypeError &e) {
+            yyverror(&@2, context, e.what());
+            YYERROR;
+        }
+    }
     | expression '.' IDENTIFIER
     {
         if ($1->type()->record()) {
@@ -997,6 +1484,9 @@ expression
 condition
     : expression
     {
+        if (stray_macro_call(&@1, context))
+            YYERROR;
+
         try {
             $$ = ast_factory::BoolUnaryFactory::create($1);
         } catch (const InvalidTypeError &e) {
@@ -1008,6 +1498,8 @@ condition
 constant
     : single_constant { $$ = $1; }
     | constant_list { $$ = $1; }
+    | constant_dict { $$ = $1; }
+    | constant_set { $$ = $1; }
     ;
 
 single_constant
@@ -1062,6 +1554,56 @@ list
     }
     ;
 
+dict
+    : dict_type '{' dict_values '}'
+    {
+        /* The entries are given as keys followed by their values, split
+         * them into a list of keys and a list of values */
+        ast::ExpressionList *keys = $3;
+        ast::ExpressionList *values = $3->next;
+
+        for (auto k = keys; k != nullptr; k = k->next) {
+            ast::ExpressionList *v = k->next;
+
+            if (k->expression->type() != $1->key()) {
+                yyverror(&@3, context,
+                    "wrong type of dictionary key (got %s, expected %s)",
+                    k->expression->type()->str().c_str(),
+                    $1->key()->str().c_str());
+                YYERROR;
+            }
+            if (v->expression->type() != $1->value()) {
+                yyverror(&@3, context,
+                    "wrong type of dictionary value (got %s, expected %s)",
+                    v->expression->type()->str().c_str(),
+                    $1->value()->str().c_str());
+                YYERROR;
+            }
+
+            k->next = v->next;
+            v->next = v->next ? v->next->next : nullptr;
+        }
+
+        $$ = new ast::Dict($1);
+        $$->set_entries(keys, values);
+    }
+    | dict_type
+    {
+        $$ = new ast::Dict($1);
+    }
+    ;
+
+dict_values
+    : expression ':' expression ',' dict_values
+    {
+        $$ = new ast::ExpressionList($1, new ast::ExpressionList($3, $5));
+    }
+    | expression ':' expression
+    {
+        $$ = new ast::ExpressionList($1, new ast::ExpressionList($3));
+    }
+    ;
+
 list_values
     : expression ',' list_values
     {
@@ -1168,17 +1710,27 @@ function_args
 function_call
     : IDENTIFIER '(' function_args ')'
     {
-        try {
-            $$ = ast_factory::FunctionCallFactory::create($1, $3);
-        } catch (const ast_factory::NoSuchFunctionError &e) {
-            yyerror(&@3, context, e.what());
-            YYERROR;
-        } catch (const ast_factory::WrongLambdaSignatureError &e) {
-            yyerror(&@3, context, e.what());
-            YYERROR;
-        } catch (const ast_factory::WrongFunctionSignatureError &e) {
-            yyerror(&@3, context, e.what());
-            YYERROR;
+        auto m = context->data->macros.find($1);
+
+        if (m != context->data->macros.end()) {
+            if (!($$ = macro_call(&@1, context, m->second, $3)))
+                YYERROR;
+        } else {
+            try {
+                $$ = ast_factory::FunctionCallFactory::create($1, $3);
+            } catch (const ast_factory::NoSuchFunctionError &e) {
+                yyerror(&@3, context, e.what());
+                YYERROR;
+            } catch (const ast_factory::WrongLambdaSignatureError &e) {
+                yyerror(&@3, context, e.what());
+                YYERROR;
+            } catch (const ast_factory::WrongFunctionSignatureError &e) {
+                yyerror(&@3, context, e.what());
+                YYERROR;
+            } catch (const InvalidTypeError &e) {
+                yyerror(&@3, context, e.what());
+                YYERROR;
+            }
         }
     }
     ;
@@ -1,7 +1,26 @@
 #include "py_backend.hpp"
+#include "accumulate.hpp"
+#include "memo.hpp"
+#include "optimizer.hpp"
 
 namespace py_backend
 {
+    string PyVariableCreator::next()
+    {
+        static const set<string> reserved = {
+            "and", "as", "def", "del", "for", "if", "in", "is", "not",
+            "or", "try", "all", "any", "copy", "dict", "iter", "len",
+            "list", "map", "max", "min", "next", "open", "os", "set",
+            "str", "sum", "sys", "type", "write"
+        };
+        string s;
+
+        do {
+            s = AsciiStringCreator::next();
+        } while (reserved.count(s));
+        return s;
+    }
+
     /** Converts a TeGeL constant to the corresponding constant in Python
      *
      */
@@ -48,6 +67,34 @@ namespace py_backend
                 }
                 os_ << ")";
             }
+
+            virtual void visit(const DictConstantData *p) {
+                auto it = p->begin();
+                auto end = p->end();
+
+                os_ << "{";
+                while (it != end) {
+                    it->first->accept(*this);
+                    os_ << ": ";
+                    it->second->accept(*this);
+                    if (++it != end)
+                        os_ << ", ";
+                }
+                os_ << "}";
+            }
+
+            virtual void visit(const SetConstantData *p) {
+                auto it = p->begin();
+                auto end = p->end();
+
+                os_ << "set([";
+                while (it != end) {
+                    (*it)->accept(*this);
+                    if (++it != end)
+                        os_ << ", ";
+                }
+                os_ << "])";
+            }
         protected:
             ostream &os_;
     };
@@ -84,6 +131,8 @@ namespace py_backend
             }
 
             virtual void visit(const ListType *) { }
+            virtual void visit(const DictType *) { }
+            virtual void visit(const SetType *) { }
         private:
             ostream &os_;
     };
@@ -121,11 +170,136 @@ namespace py_backend
             }
 
             virtual void visit(const ListType *) { }
+            virtual void visit(const DictType *) { }
+            virtual void visit(const SetType *) { }
         private:
             ostream &os_;
             int index_;
     };
 
+    /** Outputs a cast of a command line string to the proper type (used for
+     * the keys and the values of dictionaries)
+     *
+     */
+    class PyCast : public TypeVisitor
+    {
+        public:
+            PyCast(ostream &os, const string &s)
+                : os_(os), s_(s) {}
+
+            virtual void visit(const RecordType *p) {
+                os_ << "parse_" << PyUtils::record_name(p) << "(" << s_
+                    << ")";
+            }
+
+            virtual void visit(const BoolType *) {
+                os_ << "parse_bool(" << s_ << ")";
+            }
+
+            virtual void visit(const IntType *) {
+                os_ << "int(" << s_ << ")";
+            }
+
+            virtual void visit(const StringType *) {
+                os_ << s_;
+            }
+
+            virtual void visit(const ListType *) { }
+            virtual void visit(const DictType *) { }
+            virtual void visit(const SetType *) { }
+        private:
+            ostream &os_;
+            string s_;
+    };
+
+    /** Outputs a conversion of a decoded JSON value to the proper type (used
+     * for the fields of records that aren't flat)
+     *
+     */
+    class PyJsonCast : public TypeVisitor
+    {
+        public:
+            PyJsonCast(ostream &os, const string &s)
+                : os_(os), s_(s) {}
+
+            virtual void visit(const RecordType *p) {
+                os_ << "json_" << PyUtils::record_name(p) << "(" << s_ << ")";
+            }
+
+            virtual void visit(const BoolType *) {
+                os_ << "bool(" << s_ << ")";
+            }
+
+            virtual void visit(const IntType *) {
+                os_ << "int(" << s_ << ")";
+            }
+
+            virtual void visit(const StringType *) {
+                os_ << s_;
+            }
+
+            virtual void visit(const ListType *p) {
+                PyJsonCast e(os_, "x");
+
+                os_ << "[";
+                p->elem()->accept(e);
+                os_ << " for x in " << s_ << "]";
+            }
+
+            virtual void visit(const DictType *) { }
+            virtual void visit(const SetType *) { }
+        private:
+            ostream &os_;
+            string s_;
+    };
+
+    /** Outputs the default value of a type (used for the elements that are
+     * accessed out of range)
+     *
+     */
+    class PyDefault : public TypeVisitor
+    {
+        public:
+            PyDefault(ostream &os)
+                : os_(os) {}
+
+            virtual void visit(const RecordType *p) {
+                os_ << PyUtils::record_name(p) << "(";
+                for (auto it = p->begin(); it != p->end(); ++it) {
+                    if (it != p->begin())
+                        os_ << ", ";
+                    it->type->accept(*this);
+                }
+                os_ << ")";
+            }
+
+            virtual void visit(const BoolType *) {
+                os_ << "False";
+            }
+
+            virtual void visit(const IntType *) {
+                os_ << "0";
+            }
+
+            virtual void visit(const StringType *) {
+                os_ << "\"\"";
+            }
+
+            virtual void visit(const ListType *) {
+                os_ << "[]";
+            }
+
+            virtual void visit(const DictType *) {
+                os_ << "{}";
+            }
+
+            virtual void visit(const SetType *) {
+                os_ << "set()";
+            }
+        private:
+            ostream &os_;
+    };
+
     /** Helper function for PyConstToStream
      *
      */
@@ -136,6 +310,13 @@ namespace py_backend
         return os;
     }
 
+    ostream &PyUtils::default_to_stream(ostream &os, const Type *t)
+    {
+        PyDefault d(os);
+        t->accept(d);
+        return os;
+    }
+
     /** Returns the record name (the name used for the named tuples)
      *
      */
@@ -144,6 +325,14 @@ namespace py_backend
         return "tuple_" + r->str();
     }
 
+    /** Returns the name used for the dictionary's parse function
+     *
+     */
+    string PyUtils::dict_name(const DictType *d)
+    {
+        return "dict_" + d->key()->str() + "_" + d->value()->str();
+    }
+
     bool PyUtils::is_short_cmd(const string &s)
     {
         return (s.length() == 2 && s[0] == '-' && isalpha(s[1]));
@@ -214,6 +403,18 @@ namespace py_backend
         } else if (t->record()) {
             os << ", type=parse_"
                << PyUtils::record_name(t->record());
+        } else if (t->dict()) {
+            os << ", nargs=\"+\", type=parse_"
+               << PyUtils::dict_name(t->dict());
+        } else if (t->set()) {
+            auto e = t->set()->elem();
+
+            if (e == TypeFactory::get("bool"))
+                os << ", nargs=\"+\", type=parse_bool";
+            else if (e == TypeFactory::get("int"))
+                os << ", nargs=\"+\", type=int";
+            else if (e == TypeFactory::get("string"))
+                os << ", nargs=\"+\", type=str";
         }
 
         PyConstToStream pcs(os);
@@ -275,10 +476,13 @@ namespace py_backend
         unindent() << "from __future__ import unicode_literals\n\n";
         unindent() << "import argparse\n";
         unindent() << "import errno\n";
+        unindent() << "import json\n";
         unindent() << "import os\n";
         unindent() << "import sys\n";
         unindent() << "import textwrap\n";
-        unindent() << "from collections import namedtuple\n\n";
+        unindent() << "from collections import namedtuple\n";
+        unindent() << "from functools import reduce\n";
+        unindent() << "from operator import attrgetter, itemgetter\n\n";
 
         unindent() << "def parse_bool(s):\n";
         unindent() << "    return True if s.lower() == \"y\" "
@@ -327,6 +531,20 @@ namespace py_backend
         unindent() << "    else:\n";
         unindent() << "        f.buffer.write(s.encode('utf-8'))\n\n";
 
+        /* Collects the output of a memo block */
+        unindent() << "class Capture(object):\n";
+        unindent() << "    def __init__(self):\n";
+        unindent() << "        self.buffer = self\n";
+        unindent() << "        self.parts = []\n\n";
+        unindent() << "    def write(self, b):\n";
+        unindent() << "        self.parts.append(b)\n\n";
+        unindent() << "    def text(self):\n";
+        unindent() << "        return b\"\".join(self.parts).decode('utf-8')\n\n";
+
+        /* Ranges that are only iterated over are lazy in Python 2 too */
+        unindent() << "if sys.version_info < (3, 0):\n";
+        unindent() << "    range = xrange\n\n";
+
         unindent() << "def to_str(x):\n";
         unindent() << "    if type(x) == bool:\n";
         unindent() << "        return 'true' if x else 'false'\n";
@@ -360,7 +578,72 @@ namespace py_backend
         unindent() << "        return o.tuple()\n";
         unindent() << "    return o\n\n";
 
+        unindent() << "def index_by(f, l):\n";
+        unindent() << "    return dict((f(x), x) for x in l)\n\n";
+
+        unindent() << "def dict_values(d):\n";
+        unindent() << "    return [ d[k] for k in sorted(d) ]\n\n";
+
+        /* The groups are returned in the order that their keys were first
+         * seen in */
+        unindent() << "def group_by(f, l, t):\n";
+        unindent() << "    groups = {}\n";
+        unindent() << "    keys = []\n";
+        unindent() << "    for x in l:\n";
+        unindent() << "        k = f(x)\n";
+        unindent() << "        g = groups.get(k)\n";
+        unindent() << "        if g is None:\n";
+        unindent() << "            g = groups[k] = []\n";
+        unindent() << "            keys.append(k)\n";
+        unindent() << "        g.append(x)\n";
+        unindent() << "    return [ t(k, groups[k]) for k in keys ]\n\n";
+
+        /* Stable sorts by the least significant key first */
+        unindent() << "def sort_by(l, keys):\n";
+        unindent() << "    l = list(l)\n";
+        unindent() << "    for key, ascending in reversed(keys):\n";
+        unindent() << "        l.sort(key=key, reverse=not ascending)\n";
+        unindent() << "    return l\n\n";
+
+        /* Keeps the first element of each key, found by hashing */
+        unindent() << "def unique(l, key):\n";
+        unindent() << "    seen = set()\n";
+        unindent() << "    r = []\n";
+        unindent() << "    for x in l:\n";
+        unindent() << "        k = x if key is None else key(x)\n";
+        unindent() << "        if k not in seen:\n";
+        unindent() << "            seen.add(k)\n";
+        unindent() << "            r.append(x)\n";
+        unindent() << "    return r\n\n";
+
+        /* Elements out of range are the default value d */
+        unindent() << "def list_at(l, i, d):\n";
+        unindent() << "    return l[i] if -len(l) <= i < len(l) else d\n\n";
+
+        /* Iterates over l[a:b] without copying it */
+        unindent() << "def list_view(l, a, b):\n";
+        unindent() << "    return (l[i] for i in range(*slice(a, b)"
+                   ".indices(len(l))))\n\n";
+
+        /* min() and max() of an empty list are the default value d */
+        unindent() << "def minimum(l, d):\n";
+        unindent() << "    l = iter(l)\n";
+        unindent() << "    r = next(l, d)\n";
+        unindent() << "    for x in l:\n";
+        unindent() << "        if x < r:\n";
+        unindent() << "            r = x\n";
+        unindent() << "    return r\n\n";
+
+        unindent() << "def maximum(l, d):\n";
+        unindent() << "    l = iter(l)\n";
+        unindent() << "    r = next(l, d)\n";
+        unindent() << "    for x in l:\n";
+        unindent() << "        if x > r:\n";
+        unindent() << "            r = x\n";
+        unindent() << "    return r\n\n";
+
         generate_records();
+        generate_dicts();
     }
 
     /** Generates the record declarations
@@ -368,14 +651,33 @@ namespace py_backend
      */
     void PyHeader::generate_records()
     {
+        /* The records that aren't flat, and the records that they hold, are
+         * converted from JSON */
+        set<const RecordType *> json;
+
+        for (const RecordType *r : TypeFactory::get_records()) {
+            if (r->flat())
+                continue;
+
+            json.insert(r);
+            for (auto it = r->begin(); it != r->end(); ++it) {
+                const Type *t = (*it).type;
+
+                if (t->list())
+                    t = t->list()->elem();
+                if (t->record())
+                    json.insert(t->record());
+            }
+        }
+
         for (const RecordType *r : TypeFactory::get_records())
-            generate_record(r);
+            generate_record(r, json.count(r) != 0);
     }
 
     /** Generates a record declaration using collections.namedtuple
      *
      */
-    void PyHeader::generate_record(const RecordType *r)
+    void PyHeader::generate_record(const RecordType *r, bool json)
     {
         string name = PyUtils::record_name(r);
         unindent() << name << " = namedtuple(\""
@@ -391,6 +693,32 @@ namespace py_backend
 
         unindent() << "])\n\n";
 
+        if (json) {
+            unindent() << "def json_" << name << "(v):\n";
+            unindent() << "    return " << name << "(";
+            for (auto it = r->begin(); it != r->end(); ++it) {
+                PyJsonCast jc(unindent(), "v[\"" + (*it).name + "\"]");
+
+                if (it != r->begin())
+                    unindent() << ", ";
+                (*it).type->accept(jc);
+            }
+            unindent() << ")\n\n";
+        }
+
+        /* Records of primitives are parsed from colon delimited strings, and
+         * other records from JSON objects */
+        if (!r->flat()) {
+            unindent() << "def parse_" << name << "(s):\n";
+            unindent() << "    try:\n";
+            unindent() << "        return json_" << name << "(json.loads(s))\n";
+            unindent() << "    except:\n";
+            unindent() << "        raise argparse.ArgumentTypeError("
+                       "\"Expected a JSON object of type " << r->str()
+                       << "\")\n\n";
+            return;
+        }
+
         unindent() << "def parse_" << name << "(s):\n";
         unindent() << "    rs = \"";
         PyRecordColonDelim rcd(unindent());
@@ -410,15 +738,57 @@ namespace py_backend
                    "\"Expected a string of type \" + rs)\n";
     }
 
+    /** Generates the command line parse functions for the dictionaries
+     *
+     */
+    void PyHeader::generate_dicts()
+    {
+        for (const DictType *d : TypeFactory::get_dicts())
+            generate_dict(d);
+    }
+
+    /** Generates a parse function for a key=value command line string
+     *
+     */
+    void PyHeader::generate_dict(const DictType *d)
+    {
+        PyRecordColonDelim kcd(unindent());
+        PyRecordColonDelim vcd(unindent());
+        PyCast kc(unindent(), "k");
+        PyCast vc(unindent(), "v");
+
+        unindent() << "\ndef parse_" << PyUtils::dict_name(d) << "(s):\n";
+        unindent() << "    ds = \"";
+        d->key()->accept(kcd);
+        unindent() << "=";
+        d->value()->accept(vcd);
+        unindent() << "\"\n";
+        unindent() << "    k, sep, v = s.partition('=')\n\n";
+        unindent() << "    if not sep:\n";
+        unindent() << "        raise argparse.ArgumentTypeError("
+                   "\"Expected a string of type \" + ds)\n";
+        unindent() << "    try:\n";
+        unindent() << "        return (";
+        d->key()->accept(kc);
+        unindent() << ", ";
+        d->value()->accept(vc);
+        unindent() << ")\n";
+        unindent() << "    except:\n";
+        unindent() << "        raise argparse.ArgumentTypeError("
+                   "\"Expected a string of type \" + ds)\n";
+    }
+
     void PyBody::generate(ast::Statements *body)
     {
         windent("def generate(_args, _file):\n");
         indent_inc();
+        write_memos(body);
         if (body)
             body->accept(*this);
         else
             indent() << "pass\n";
         indent_dec();
+        write_tables();
     }
 
     void PyBody::generate(ParseData *tgp, const map<string, ParseData *> &tgl)
@@ -429,6 +799,7 @@ namespace py_backend
         indent_inc();
         windent("if _body == \"\":\n");
         indent_inc();
+        write_memos(tgp->body);
         if (tgp->body)
             tgp->body->accept(*this);
         else
@@ -437,12 +808,31 @@ namespace py_backend
         for (auto it = tgl.begin(); it != tgl.end(); ++it) {
             indent() << "elif _body == \"" << it->first << "\":\n";
             indent_inc();
+            write_memos(it->second->body);
             if (it->second->body)
                 it->second->body->accept(*this);
             else
                 indent() << "pass\n";
             indent_dec();
         }
+        indent_dec();
+        write_tables();
+    }
+
+    void PyBody::write_tables()
+    {
+        if (num_tables_ > 0)
+            unindent() << "\n" << tables_.str();
+    }
+
+    void PyBody::write_memos(ast::Statements *body)
+    {
+        for (auto m : memo::memos(body)) {
+            unsigned n = memos_.size();
+
+            memos_[m] = n;
+            windent("_memo%i = {}\n", n);
+        }
     }
 
     void PyBody::visit(ast::Statements *p)
@@ -558,11 +948,119 @@ namespace py_backend
         binary("+", p);
     }
 
+    void PyBody::visit(ast::StringJoin *p)
+    {
+        write("\"\".join((");
+        for (auto e = p->parts(); e != nullptr; e = e->next) {
+            e->expression->accept(*this);
+            if (e->next)
+                unindent() << ", ";
+        }
+        write("))");
+    }
+
     void PyBody::visit(ast::Constant *p)
     {
         PyUtils::constant_to_stream(unindent(), p->data());
     }
 
+    /** Returns the index of the record field that a constant string names,
+     * or -1 if it's not a constant or not a field */
+    static int constant_field(const RecordType *r, ast::Expression *e)
+    {
+        ast::Constant *c = e->constant();
+        int i = 0;
+
+        if (!c || c->type() != TypeFactory::get("string"))
+            return -1;
+
+        string name = static_cast<const StringConstantData *>(c->data())->value();
+
+        for (auto it = r->begin(); it != r->end(); ++it, ++i) {
+            if ((*it).name == name)
+                return i;
+        }
+        return -1;
+    }
+
+    /** Returns true if both expressions are the same constant bool */
+    static bool same_order(ast::Expression *a, ast::Expression *b)
+    {
+        ast::Constant *x = a->constant(), *y = b->constant();
+
+        return x && y && x->type() == TypeFactory::get("bool") &&
+               y->type() == TypeFactory::get("bool") &&
+               static_cast<const BoolConstantData *>(x->data())->value() ==
+               static_cast<const BoolConstantData *>(y->data())->value();
+    }
+
+    void PyBody::write_sorted(const function<void()> &list,
+                              ast::ExpressionList *args, const Type *elem)
+    {
+        if (!elem->record()) {
+            write("sorted(");
+            list();
+            write(", reverse=not %a)", args->expression);
+            return;
+        }
+
+        /* Records are sorted by (field, ascending) pairs. Consecutive fields
+         * that are sorted in the same order share a tuple key, so that the
+         * common case is a single sort */
+        struct Key
+        {
+            vector<ast::Expression *> fields;
+            ast::Expression *ascending;
+        };
+        vector<Key> keys;
+
+        for (auto a = args; a != nullptr; a = a->next->next) {
+            if (!keys.empty() && same_order(keys.back().ascending,
+                                            a->next->expression))
+                keys.back().fields.push_back(a->expression);
+            else
+                keys.push_back({ { a->expression }, a->next->expression });
+        }
+
+        /* The key is computed once per element, by position if the fields
+         * are known */
+        auto write_key = [&](const Key &k) {
+            vector<int> indices;
+
+            for (auto f : k.fields)
+                indices.push_back(constant_field(elem->record(), f));
+
+            if (find(indices.begin(), indices.end(), -1) == indices.end()) {
+                write("itemgetter(");
+                for (auto it = indices.begin(); it != indices.end(); ++it)
+                    write(it == indices.begin() ? "%i" : ", %i", *it);
+            } else {
+                write("attrgetter(");
+                for (auto it = k.fields.begin(); it != k.fields.end(); ++it)
+                    write(it == k.fields.begin() ? "%a" : ", %a", *it);
+            }
+            write(")");
+        };
+
+        if (keys.size() == 1) {
+            write("sorted(");
+            list();
+            write(", key=");
+            write_key(keys[0]);
+            write(", reverse=not %a)", keys[0].ascending);
+        } else {
+            write("sort_by(");
+            list();
+            write(", [");
+            for (auto it = keys.begin(); it != keys.end(); ++it) {
+                write(it == keys.begin() ? "(" : ", (");
+                write_key(*it);
+                write(", %a)", it->ascending);
+            }
+            write("])");
+        }
+    }
+
     void PyBody::visit(ast::MethodCall *p)
     {
         auto t = p->expression()->type();
@@ -584,12 +1082,18 @@ namespace py_backend
                 write("to_str(%a)", e);
             }
         } else if (t == type::TypeFactory::get("int")) {
+            bool lazy = iterated_.count(p);
+
             if (name == "downto") {
-                write("list(reversed(range(%a, %a + 1)))", a0, e);
+                if (lazy)
+                    write("range(%a, %a - 1, -1)", e, a0);
+                else
+                    write("list(reversed(range(%a, %a + 1)))", a0, e);
             } else if (name == "str") {
                 write("str(%a)", e);
             } else if (name == "upto") {
-                write("list(range(%a, %a + 1))", e, a0);
+                write(lazy ? "range(%a, %a + 1)" : "list(range(%a, %a + 1))",
+                      e, a0);
             }
         } else if (t == type::TypeFactory::get("string")) {
             if (name == "lalign") {
@@ -611,24 +1115,188 @@ namespace py_backend
             }
         } else if (t->record()) {
             if (name == "elems") {
-                write("map(lambda x: to_str(x), list(%a))", e);
+                write("list(map(lambda x: to_str(x), list(%a)))", e);
             }
-        } else if (t->list()) {
-            if (name == "size") {
+        } else if (t->set()) {
+            if (name == "difference") {
+                write("(%a - %a)", e, a0);
+            } else if (name == "has") {
+                write("(%a in %a)", a0, e);
+            } else if (name == "intersection") {
+                write("(%a & %a)", e, a0);
+            } else if (name == "list") {
+                write("sorted(%a)", e);
+            } else if (name == "size") {
                 write("len(%a)", e);
-            } else if (name == "sort") {
-                if (t->list()->elem()->primitive()) {
-                    write("sorted(%a, reverse=not %a)", e, a0);
-                } else if (t->list()->elem()->record()) {
-                    write("sorted(%a, reverse=not %a, "
-                          "key=lambda r: getattr(r, %a))", e, a1, a0);
+            } else if (name == "union") {
+                write("(%a | %a)", e, a0);
+            }
+        } else if (t->dict()) {
+            if (name == "get") {
+                write("%a[%a]", e, a0);
+            } else if (name == "has") {
+                write("(%a in %a)", a0, e);
+            } else if (name == "keys") {
+                write("sorted(%a)", e);
+            } else if (name == "size") {
+                write("len(%a)", e);
+            } else if (name == "values") {
+                write("dict_values(%a)", e);
+            }
+        } else if (t->list()) {
+            if (name == "at") {
+                iterate(e, true);
+                write("list_at(%a, %a, ", e, a0);
+                PyUtils::default_to_stream(unindent(), t->list()->elem());
+                write(")");
+            } else if (name == "from" || name == "slice") {
+                /* A slice that is only iterated over is a view of the list
+                 * (or range) */
+                if (iterated_.count(p)) {
+                    iterate(e, true);
+                    write(a1 ? "list_view(%a, %a, %a)" :
+                          "list_view(%a, %a, None)", e, a0, a1);
+                } else if (a1) {
+                    write("%a[%a:%a]", e, a0, a1);
+                } else {
+                    write("%a[%a:]", e, a0);
                 }
+            } else if (name == "size") {
+                iterate(e, true);
+                write("len(%a)", e);
+            } else if (name == "sort" || name == "sort_by") {
+                write_sorted([&]() { write("%a", e); }, p->arguments(),
+                             t->list()->elem());
             } else if (name == "join") {
                 write("%a.join(%a)", a0, e);
             }
         }
     }
 
+    void PyBody::visit(ast::Pipeline *p)
+    {
+        enum ClauseKind { FOR_SOURCE, FOR_BIND, IF };
+        struct Clause {
+            ClauseKind kind;
+            string name;
+            ast::AST_Node *node;
+        };
+        vector<Clause> clauses;
+        bool filtered = false;
+        bool speculatable = true;
+
+        /* The stages are generated as the clauses of one comprehension. A
+         * stage's variable is bound to the current element by a for clause,
+         * unless the element is already held by a variable (i.e. in the
+         * first stage, or after a filter), in which case the stage's variable
+         * is just an alias of that variable */
+        string current = table_.get(p->stages()[0].lambda->variables->
+                                    statement->variable());
+        ast::Expression *element = nullptr;
+
+        iterate(p->source());
+        clauses.push_back(Clause{FOR_SOURCE, current, p->source()});
+        for (auto &s : p->stages()) {
+            auto v = s.lambda->variables->statement->variable();
+
+            if (element) {
+                current = table_.get(v);
+                clauses.push_back(Clause{FOR_BIND, current, element});
+                element = nullptr;
+            } else {
+                table_.alias(v, current);
+            }
+
+            if (s.kind == ast::Pipeline::FILTER) {
+                clauses.push_back(Clause{IF, "", s.lambda->expression});
+                filtered = true;
+            } else {
+                element = s.lambda->expression;
+                speculatable = speculatable &&
+                    optimizer::is_speculatable(element);
+            }
+        }
+
+        auto write_clauses = [&]() {
+            for (auto &c : clauses) {
+                if (c.kind == FOR_SOURCE)
+                    write(" for %s in %a", c.name.c_str(), c.node);
+                else if (c.kind == FOR_BIND)
+                    write(" for %s in (%a,)", c.name.c_str(), c.node);
+                else
+                    write(" if %a", c.node);
+            }
+        };
+        auto write_element = [&]() {
+            if (element)
+                write("%a", element);
+            else
+                write("%s", current.c_str());
+            write_clauses();
+        };
+        auto write_list = [&]() {
+            write("[");
+            write_element();
+            write("]");
+        };
+        auto write_sorted = [&]() {
+            const Type *elem = p->source()->type()->list()->elem();
+
+            for (auto &s : p->stages()) {
+                if (s.kind == ast::Pipeline::MAP)
+                    elem = s.lambda->expression->type();
+            }
+            this->write_sorted(write_list, p->sort(), elem);
+        };
+
+        if (p->reduce() == "size") {
+            if (p->sort() && p->sort()->next) {
+                /* Sorting records can fail on unknown fields, keep it */
+                write("len(");
+                write_sorted();
+                write(")");
+            } else if (filtered) {
+                write("sum(1");
+                write_clauses();
+                write(")");
+            } else if (speculatable) {
+                /* Neither sorting nor mapping changes the length */
+                iterate(p->source(), true);
+                write("len(%a)", p->source());
+            } else {
+                write("len(");
+                write_list();
+                write(")");
+            }
+        } else if (p->reduce() == "join") {
+            write("%a.join(", p->reduce_arguments()->expression);
+            if (p->sort())
+                write_sorted();
+            else
+                write_list();
+            write(")");
+        } else if (p->reduce() == "min" || p->reduce() == "max") {
+            /* The elements are generated, not collected in a list */
+            write("%s((", p->reduce() == "min" ? "minimum" : "maximum");
+            write_element();
+            write("), %s)", p->type() == TypeFactory::get("string") ?
+                  "\"\"" : "0");
+        } else if (!p->reduce().empty()) {
+            /* sum(), any() and all() */
+            write("%s(", p->reduce().c_str());
+            write_element();
+            write(")");
+        } else if (p->sort()) {
+            write_sorted();
+        } else if (iterated_.count(p)) {
+            write("(");
+            write_element();
+            write(")");
+        } else {
+            write_list();
+        }
+    }
+
     void PyBody::visit(ast::LambdaExpression *p)
     {
         write("lambda ");
@@ -643,12 +1311,66 @@ namespace py_backend
 
     void PyBody::visit(ast::FunctionCall *p)
     {
+        bool unary = (p->name == "set" || p->name == "unique");
+
+        /* Every builtin iterates over its list argument once */
+        if (unary || p->name == "zip")
+            iterate(p->args->get_expression(0));
+        if (!unary)
+            iterate(p->args->get_expression(1));
+
         if (p->name == "filter") {
-            write("filter(%a, %a)", p->args->get_lambda(0),
+            write(iterated_.count(p) ? "filter(%a, %a)" :
+                  "list(filter(%a, %a))", p->args->get_lambda(0),
                   p->args->get_expression(1));
         } else if (p->name == "map") {
-            write("map(%a, %a)", p->args->get_lambda(0),
+            write(iterated_.count(p) ? "map(%a, %a)" : "list(map(%a, %a))",
+                  p->args->get_lambda(0), p->args->get_expression(1));
+        } else if (p->name == "set") {
+            write("set(%a)", p->args->get_expression(0));
+        } else if (p->name == "unique") {
+            write("unique(%a, None)", p->args->get_expression(0));
+        } else if (p->name == "distinct") {
+            write("unique(%a, %a)", p->args->get_expression(1),
+                  p->args->get_lambda(0));
+        } else if (p->name == "zip") {
+            auto pair = p->type()->list()->elem()->record();
+
+            write(iterated_.count(p) ? "map(%s._make, zip(%a, %a))" :
+                  "list(map(%s._make, zip(%a, %a)))",
+                  PyUtils::record_name(pair).c_str(),
+                  p->args->get_expression(0), p->args->get_expression(1));
+        } else if (p->name == "index_by") {
+            write("index_by(%a, %a)", p->args->get_lambda(0),
                   p->args->get_expression(1));
+        } else if (p->name == "group_by") {
+            auto group = p->type()->list()->elem()->record();
+
+            write("group_by(%a, %a, %s)", p->args->get_lambda(0),
+                  p->args->get_expression(1),
+                  PyUtils::record_name(group).c_str());
+        } else if (p->aggregation()) {
+            ast::LambdaExpression *l = p->args->get_lambda(0);
+            string v = table_.get(l->variables->statement->variable());
+
+            /* The lambda expression is inlined in a generator expression,
+             * so that no list is created */
+            if (p->name == "count") {
+                write("sum(1 for %s in %a if %a)", v.c_str(),
+                      p->args->get_expression(1), l->expression);
+            } else if (p->name == "min" || p->name == "max") {
+                write("%s((%a for %s in %a), %s)",
+                      p->name == "min" ? "minimum" : "maximum",
+                      l->expression, v.c_str(), p->args->get_expression(1),
+                      p->type() == TypeFactory::get("string") ?
+                      "\"\"" : "0");
+            } else {
+                write("%s(%a for %s in %a)", p->name.c_str(), l->expression,
+                      v.c_str(), p->args->get_expression(1));
+            }
+        } else if (p->name == "reduce") {
+            write("reduce(%a, %a, %a)", p->args->get_lambda(0),
+                  p->args->get_expression(1), p->args->get_expression(2));
         }
     }
 
@@ -662,7 +1384,23 @@ namespace py_backend
 
     void PyBody::visit(ast::FieldRef *p)
     {
-        write("%a.%s", p->record(), p->field().c_str());
+        ast::SymbolRef *r = p->record()->symbol_ref();
+
+        if (r && loops_.count(r->symbol())) {
+            string l = table_.get(r->symbol());
+            string f = p->field();
+
+            if (f == "index")
+                write("%s_i", l.c_str());
+            else if (f == "first")
+                write("(%s_i == 0)", l.c_str());
+            else if (f == "last")
+                write("(%s_i == %s_n - 1)", l.c_str(), l.c_str());
+            else if (f == "length")
+                write("%s_n", l.c_str());
+        } else {
+            write("%a.%s", p->record(), p->field().c_str());
+        }
     }
 
     void PyBody::visit(ast::List *p)
@@ -687,6 +1425,20 @@ namespace py_backend
         write(")");
     }
 
+    void PyBody::visit(ast::Dict *p)
+    {
+        auto v = p->values();
+
+        write("{");
+        for (auto k = p->keys(); k != nullptr; k = k->next) {
+            write("%a: %a", k->expression, v->expression);
+            if (k->next)
+                write(", ");
+            v = v->next;
+        }
+        write("}");
+    }
+
     void PyBody::visit(ast::FuncArgList *) {
 
     }
@@ -701,6 +1453,11 @@ namespace py_backend
 
     void PyBody::visit(ast::Conditional *p)
     {
+        if (p->dispatch_subject()) {
+            dispatch(p);
+            return;
+        }
+
         p->if_node()->accept(*this);
         if (p->elif_nodes())
             p->elif_nodes()->accept(*this);
@@ -708,30 +1465,179 @@ namespace py_backend
             p->else_node()->accept(*this);
     }
 
+    void PyBody::accumulate_begin(const vector<symbol::Variable *> &vars)
+    {
+        /* Lists are appended to in place, so the list must not be shared
+         * with any other variable. Strings are collected in a list that is
+         * joined after the loop */
+        for (auto v : vars) {
+            string n = table_.get(v);
+
+            if (v->get_type()->list())
+                windent("%s = list(%s)\n", n.c_str(), n.c_str());
+            else
+                windent("%s_buf = [%s]\n", n.c_str(), n.c_str());
+        }
+    }
+
+    void PyBody::accumulate_end(const vector<symbol::Variable *> &vars)
+    {
+        for (auto v : vars) {
+            string n = table_.get(v);
+
+            if (!v->get_type()->list())
+                windent("%s = \"\".join(%s_buf)\n", n.c_str(), n.c_str());
+        }
+    }
+
+    void PyBody::dispatch(ast::Conditional *p)
+    {
+        /* The table maps each key to the index of its branch, and the
+         * branch is then found with a binary search on the index. The
+         * index of the else branch is the number of keys */
+        auto &keys = p->dispatch_keys();
+        vector<ast::Scope *> branches(1, p->if_node());
+        stringstream name;
+
+        for (auto e = p->elif_nodes(); e != nullptr; e = e->next())
+            branches.push_back(e);
+        branches.push_back(p->else_node());
+
+        name << "_dispatch" << num_tables_++;
+        tables_ << name.str() << " = {";
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i > 0)
+                tables_ << ", ";
+            PyUtils::constant_to_stream(tables_, keys[i]->data());
+            tables_ << ": " << i;
+        }
+        tables_ << "}\n";
+
+        windent("_branch = %s.get(%a, %i)\n", name.str().c_str(),
+                p->dispatch_subject(), static_cast<int>(keys.size()));
+        dispatch(branches, 0, keys.size());
+    }
+
+    void PyBody::dispatch(const vector<ast::Scope *> &branches, size_t lo,
+                          size_t hi)
+    {
+        if (lo == hi) {
+            if (branches[lo] && branches[lo]->statements())
+                branches[lo]->statements()->accept(*this);
+            else
+                windent("pass\n");
+            return;
+        }
+
+        size_t mid = (lo + hi) / 2;
+
+        windent("if _branch <= %i:\n", static_cast<int>(mid));
+        indent_inc();
+        dispatch(branches, lo, mid);
+        indent_dec();
+        windent("else:\n");
+        indent_inc();
+        dispatch(branches, mid + 1, hi);
+        indent_dec();
+    }
+
     void PyBody::visit(ast::ForEach *p)
     {
-        if (p->statements()) {
-            windent("%s = Loop(%a)\n", table_.get(p->loop_variable()).c_str(),
-                    p->expression());
-            windent("for %s in %s.list:\n", table_.get(p->variable()).c_str(),
-                    table_.get(p->loop_variable()).c_str());
+        accumulate_begin(p->accumulators());
+        loop(p);
+        accumulate_end(p->accumulators());
+    }
+
+    void PyBody::iterate(ast::Expression *e, bool sized)
+    {
+        ast::MethodCall *m = e->method_call();
+        ast::Pipeline *p = e->pipeline();
+        ast::FunctionCall *f = e->function_call();
+
+        /* Ranges have a length, generators don't */
+        if (m && (m->method().name() == "upto" ||
+                  m->method().name() == "downto"))
+            iterated_.insert(e);
+        else if (p && !sized && !p->sort() && p->reduce().empty())
+            iterated_.insert(e);
+        else if (f && !sized && (f->name == "map" || f->name == "filter" ||
+                                 f->name == "zip"))
+            iterated_.insert(e);
+        else if (m && !sized && (m->method().name() == "slice" ||
+                                 m->method().name() == "from"))
+            iterated_.insert(e);
+    }
+
+    void PyBody::loop(ast::ForEach *p)
+    {
+        if (!p->statements())
+            return;
+
+        auto usage = optimizer::record_usage(p->statements(),
+                                             p->loop_variable());
+        string l = table_.get(p->loop_variable());
+        string v = table_.get(p->variable());
+
+        if (usage.whole) {
+            iterate(p->expression(), true);
+            /* The loop record is used as a value, use a Loop object */
+            windent("%s = Loop(%a)\n", l.c_str(), p->expression());
+            windent("for %s in %s.list:\n", v.c_str(), l.c_str());
             indent_inc();
+            updates_.push_back(l);
             p->statements()->accept(*this);
-            indent() << table_.get(p->loop_variable()) << ".update()\n";
+            updates_.pop_back();
+            windent("%s.update()\n", l.c_str());
             indent_dec();
+            return;
+        }
+
+        /* Only do the bookkeeping needed by the fields that are read */
+        bool length = usage.uses("length") || usage.uses("last");
+        bool index = usage.uses("index") || usage.uses("first") ||
+            usage.uses("last");
+
+        iterate(p->expression(), length);
+
+        if (length) {
+            windent("%s = %a\n", l.c_str(), p->expression());
+            windent("%s_n = len(%s)\n", l.c_str(), l.c_str());
+            if (index)
+                windent("for %s_i, %s in enumerate(%s):\n", l.c_str(),
+                        v.c_str(), l.c_str());
+            else
+                windent("for %s in %s:\n", v.c_str(), l.c_str());
+        } else if (index) {
+            windent("for %s_i, %s in enumerate(%a):\n", l.c_str(), v.c_str(),
+                    p->expression());
+        } else {
+            windent("for %s in %a:\n", v.c_str(), p->expression());
         }
+
+        if (usage.used())
+            loops_.insert(p->loop_variable());
+        indent_inc();
+        updates_.push_back("");
+        p->statements()->accept(*this);
+        updates_.pop_back();
+        indent_dec();
     }
 
     void PyBody::visit(ast::ForEachEnum *p)
     {
         if (p->statements()) {
+            accumulate_begin(p->accumulators());
+            iterate(p->expression());
             windent("for %s, %s in enumerate(%a):\n",
                     table_.get(p->index()).c_str(),
                     table_.get(p->value()).c_str(),
                     p->expression());
             indent_inc();
+            updates_.push_back("");
             p->statements()->accept(*this);
+            updates_.pop_back();
             indent_dec();
+            accumulate_end(p->accumulators());
         }
     }
 
@@ -767,12 +1673,13 @@ namespace py_backend
 
     void PyBody::visit(ast::Text *p)
     {
-        windent("write(_file, \"%s\")\n", Escaper()(p->text()).c_str());
+        windent("write(%s, \"%s\")\n", out_.c_str(),
+                Escaper()(p->text()).c_str());
     }
 
     void PyBody::visit(ast::InlinedExpression *p)
     {
-        windent("write(_file, %a)\n", p->expression());
+        windent("write(%s, %a)\n", out_.c_str(), p->expression());
     }
 
     void PyBody::visit(ast::VariableList *p)
@@ -784,8 +1691,32 @@ namespace py_backend
 
     void PyBody::visit(ast::VariableAssignment *p)
     {
-        windent("%s = copy(%a)\n", table_.get(p->variable()).c_str(),
-                p->expression());
+        if (p->accumulate()) {
+            string n = table_.get(p->variable());
+            bool list = p->variable()->get_type()->list();
+
+            for (auto e : optimizer::accumulated_parts(p)) {
+                ast::List *l = e->list();
+
+                if (!list)
+                    windent("%s_buf.append(%a)\n", n.c_str(), e);
+                else if (l && l->elements() && !l->elements()->next)
+                    windent("%s.append(%a)\n", n.c_str(),
+                            l->elements()->expression);
+                else
+                    windent("%s.extend(%a)\n", n.c_str(), e);
+            }
+            return;
+        }
+
+        /* Only the loop record needs to be copied, everything else is
+         * immutable */
+        if (p->variable()->get_type() == type::TypeFactory::get("loop"))
+            windent("%s = copy(%a)\n", table_.get(p->variable()).c_str(),
+                    p->expression());
+        else
+            windent("%s = %a\n", table_.get(p->variable()).c_str(),
+                    p->expression());
     }
 
     void PyBody::visit(ast::VariableDeclaration *p)
@@ -799,6 +1730,19 @@ namespace py_backend
         windent("try:\n");
         windent("    f = open_file(%a, %s)\n", p->out,
                 (p->ow_ask ? "True" : "False"));
+        if (p->rendered) {
+            windent("    if f:\n");
+            windent("        try:\n");
+            windent("            write(f, \"%s\")\n",
+                    Escaper()(p->text).c_str());
+            windent("        finally:\n");
+            windent("            f.close()\n");
+            windent("except IOError as e:\n");
+            windent("    print('Can\\'t create %%s: %%s' % (%a, "
+                    "e.strerror()))\n", p->out);
+            windent("    pass\n");
+            return;
+        }
         windent("    __args = {");
         auto pd = tgl_[p->tgl];
         for (symbol::Argument *a : pd->arguments) {
@@ -824,6 +1768,67 @@ namespace py_backend
         windent("    pass\n");
     }
 
+    void PyBody::visit(ast::Macro *p)
+    {
+        /* The function is defined inside generate(), where the arguments
+         * are, and takes the file object to write to as its first
+         * parameter */
+        windent("def _macro_%s(_file", p->name().c_str());
+        for (auto v : p->params())
+            write(", %s", table_.get(v).c_str());
+        write("):\n");
+        indent_inc();
+        if (p->statements())
+            p->statements()->accept(*this);
+        else
+            indent() << "pass\n";
+        indent_dec();
+    }
+
+    void PyBody::visit(ast::MacroCall *p)
+    {
+        windent("_macro_%s(%s", p->macro()->name().c_str(), out_.c_str());
+        for (auto a = p->arguments(); a != nullptr; a = a->next)
+            write(", %a", a->expression);
+        write(")\n");
+    }
+
+    void PyBody::visit(ast::Memo *p)
+    {
+        unsigned n = memos_[p];
+        string saved = out_;
+
+        /* The output of the body is captured the first time a key is seen,
+         * and written from the cache every time */
+        windent("_memo%i_key = %a\n", n, p->key());
+        windent("if _memo%i_key not in _memo%i:\n", n, n);
+        indent_inc();
+        if (p->statements()) {
+            windent("_memo%i_out = Capture()\n", n);
+            out_ = "_memo" + to_string(n) + "_out";
+            p->statements()->accept(*this);
+            out_ = saved;
+            windent("_memo%i[_memo%i_key] = _memo%i_out.text()\n", n, n, n);
+        } else {
+            windent("_memo%i[_memo%i_key] = \"\"\n", n, n);
+        }
+        indent_dec();
+        windent("write(%s, _memo%i[_memo%i_key])\n", out_.c_str(), n, n);
+    }
+
+    void PyBody::visit(ast::Break *)
+    {
+        windent("break\n");
+    }
+
+    void PyBody::visit(ast::Continue *)
+    {
+        /* The update at the end of the body is skipped */
+        if (!updates_.back().empty())
+            windent("%s.update()\n", updates_.back().c_str());
+        windent("continue\n");
+    }
+
     void PyBody::binary(const string &s, ast::BinaryExpression *e)
     {
         write("(%a %s %a)", e->lhs(), s.c_str(), e->rhs());
@@ -843,6 +1848,17 @@ namespace py_backend
         generate_opts(args, extra);
         unindent() << "\n";
 
+        /* The key=value pairs of the dictionary arguments, and the
+         * elements of the set arguments */
+        for (auto a : args) {
+            if (a->get_type()->dict())
+                indent() << "args." << a->get_name() << " = dict(args."
+                         << a->get_name() << ")\n";
+            else if (a->get_type()->set())
+                indent() << "args." << a->get_name() << " = set(args."
+                         << a->get_name() << ")\n";
+        }
+
         if (mkdir)
             indent() << "mkdir_chdir(args._dir)\n\n";
 
@@ -863,6 +1879,12 @@ namespace py_backend
         indent() << "            if type(v) == list:\n";
         indent() <<
                  "                setattr(args, a, [ convert_elem(e) for e in v ])\n";
+        indent() << "            elif type(v) == set:\n";
+        indent() << "                setattr(args, a, set(convert_elem(e) "
+                 "for e in v))\n";
+        indent() << "            elif type(v) == dict:\n";
+        indent() << "                setattr(args, a, dict((convert_elem(k), "
+                 "convert_elem(e)) for k, e in v.items()))\n";
         indent() << "            else:\n";
         indent() << "                setattr(args, a, convert_elem(v))\n";
 
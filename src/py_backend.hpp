@@ -1,6 +1,9 @@
 #ifndef __PYTHON_BACKEND_H__
 #define __PYTHON_BACKEND_H__
 
+#include <algorithm>
+#include <functional>
+#include <set>
 #include <sstream>
 #include <string>
 
@@ -28,7 +31,9 @@ namespace py_backend {
     struct PyUtils
     {
         static ostream &constant_to_stream(ostream &, const ConstantData *);
+        static ostream &default_to_stream(ostream &, const Type *);
         static string record_name(const RecordType *);
+        static string dict_name(const DictType *);
         static bool is_short_cmd(const string &);
         static bool is_long_cmd(const string &);
         static bool valid_cmd_format(const string &);
@@ -42,6 +47,10 @@ namespace py_backend {
         public:
             PyVariableCreator()
                 : AsciiStringCreator("") {}
+
+            /** Returns the next name that isn't a Python keyword or a
+             * name that the generated code uses (e.g. sum) */
+            string next();
     };
 
     class PySymbolTable : public BackendUntypedSymbolTable<PyVariableCreator>
@@ -63,14 +72,23 @@ namespace py_backend {
              *
              */
             void generate_records(void);
-            void generate_record(const RecordType *);
+            void generate_record(const RecordType *, bool json);
+
+            /** Generate the command line parse functions for all the
+             * dictionary types
+             *
+             */
+            void generate_dicts(void);
+            void generate_dict(const DictType *);
     };
 
     class PyBody : public PyWriter, public BackendGenerator
     {
         public:
             PyBody(ostream &os)
-                : PyWriter(os, 0), BackendGenerator(os), tgl_(), table_() {}
+                : PyWriter(os, 0), BackendGenerator(os), tgl_(), table_(),
+                  loops_(), updates_(), iterated_(), tables_(), num_tables_(0),
+                  out_("_file"), memos_() {}
 
             /** Generates a body generation function named "generate"
              *
@@ -115,6 +133,9 @@ namespace py_backend {
             virtual void visit(ast::FieldRef *);
             virtual void visit(ast::List *);
             virtual void visit(ast::Record *);
+            virtual void visit(ast::Pipeline *);
+            virtual void visit(ast::StringJoin *);
+            virtual void visit(ast::Dict *);
             virtual void visit(ast::FunctionCall *);
             virtual void visit(ast::FuncArgList *);
             virtual void visit(ast::FuncArgExpression *);
@@ -133,11 +154,63 @@ namespace py_backend {
             virtual void visit(ast::VariableAssignment *);
             virtual void visit(ast::VariableDeclaration *);
             virtual void visit(ast::Create*);
+            virtual void visit(ast::Macro *);
+            virtual void visit(ast::MacroCall *);
+            virtual void visit(ast::Memo *);
+            virtual void visit(ast::Break *);
+            virtual void visit(ast::Continue *);
         private:
             void binary(const string &s, ast::BinaryExpression *e);
+            void loop(ast::ForEach *);
+            void dispatch(ast::Conditional *);
+            void dispatch(const vector<ast::Scope *> &, size_t, size_t);
+            void write_tables();
+
+            /* Creates the caches of the memo blocks in the body */
+            void write_memos(ast::Statements *);
+
+            /* Lets the list expression be generated as a range or a
+             * generator, since it's only iterated over once. Sized tells if
+             * the length of the sequence is needed */
+            void iterate(ast::Expression *, bool sized = false);
+
+            /* Writes the list that the function writes, sorted by the
+             * arguments of sort() or sort_by() */
+            void write_sorted(const function<void()> &,
+                              ast::ExpressionList *, const Type *elem);
+
+            /* Prepares and finishes the in place accumulation of the
+             * variables around a loop */
+            void accumulate_begin(const vector<symbol::Variable *> &);
+            void accumulate_end(const vector<symbol::Variable *> &);
 
             map<string, ParseData *> tgl_;
             PySymbolTable table_;
+
+            /* Loop records that are not backed by a Loop object. The fields
+             * are instead computed from the variables <name>_i (index) and
+             * <name>_n (length) */
+            set<symbol::Symbol *> loops_;
+
+            /* The Loop objects of the loops that are being generated,
+             * innermost last ("" for loops without one), which continue
+             * has to update before skipping to the next iteration */
+            vector<string> updates_;
+
+            /* The list expressions that are generated lazily */
+            set<ast::Expression *> iterated_;
+
+            /* The dispatch tables, which are written after the generate
+             * function */
+            stringstream tables_;
+            unsigned num_tables_;
+
+            /* The file object that the output is written to, which is a
+             * Capture in the body of a memo block */
+            string out_;
+
+            /* The numbers of the memo blocks, which name their caches */
+            map<ast::Memo *, unsigned> memos_;
     };
 
     class PyMain : public PyWriter
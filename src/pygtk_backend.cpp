@@ -2,6 +2,17 @@
 
 namespace pygtk_backend
 {
+    /** Returns true if an argument of the type can be edited in the GUI, i.e.
+     * if it doesn't hold records that aren't flat. Other arguments keep the
+     * value given on the command line
+     */
+    static bool editable(const Type *t)
+    {
+        if (t->list())
+            t = t->list()->elem();
+        return !t->record() || t->record()->flat();
+    }
+
     /** Type visitor that generates a comma delimited list of gobject types
      *
      */
@@ -35,6 +46,9 @@ namespace pygtk_backend
             virtual void visit(const ListType *l) {
                 l->elem()->accept(*this);
             }
+
+            virtual void visit(const DictType *) { }
+            virtual void visit(const SetType *) { }
         private:
             ostream &os_;
     };
@@ -59,6 +73,8 @@ namespace pygtk_backend
                 os_ << "text";
             }
             virtual void visit(const ListType *) { }
+            virtual void visit(const DictType *) { }
+            virtual void visit(const SetType *) { }
             virtual void visit(const RecordType *) { }
         private:
             ostream &os_;
@@ -98,6 +114,8 @@ namespace pygtk_backend
             }
 
             virtual void visit(const ListType *) { }
+            virtual void visit(const DictType *) { }
+            virtual void visit(const SetType *) { }
         private:
             ostream &os_;
             PyGtkRendererType type_;
@@ -136,6 +154,8 @@ namespace pygtk_backend
             }
 
             virtual void visit(const ListType *) { }
+            virtual void visit(const DictType *) { }
+            virtual void visit(const SetType *) { }
         private:
             ostream &os_;
     };
@@ -176,7 +196,7 @@ namespace pygtk_backend
 
             void generate_list_decl_item(symbol::Argument *a) {
                 auto l = a->get_type()->list();
-                if (l != nullptr) {
+                if (l != nullptr && editable(l)) {
                     indent() << "'" << a->get_name() << "': {\n";
                     indent_inc();
                     indent() << "'types': (";
@@ -302,6 +322,9 @@ namespace pygtk_backend
 
             /* TODO */
 
+            if (!editable(t))
+                continue;
+
             if (t == TypeFactory::get("bool")) {
                 indent() << "self.create_bool(\"" << is << "\", \""
                          << a->get_name() << "\"),\n";
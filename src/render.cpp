@@ -0,0 +1,1082 @@
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
+
+#include "render.hpp"
+
+namespace optimizer {
+
+    /* Limits on the work done at compile time, larger templates are left to
+     * the scripts */
+    static const size_t max_output = 1 << 20;
+    static const size_t max_list = 1 << 16;
+
+    /** A value of the template language. Bools and ints are held by
+     * `integer`, strings by `str` and the elements of lists and the fields of
+     * records by `items`. The entries of dicts are held by `items` as keys
+     * followed by their values, in key order, and the elements of sets are
+     * held by `items` in ascending order */
+    struct Value
+    {
+        Value()
+            : integer(0), str(), items() {}
+
+        long long integer;
+        string str;
+        vector<Value> items;
+    };
+
+    static Value bool_value(bool b)
+    {
+        Value v;
+        v.integer = b;
+        return v;
+    }
+
+    static Value int_value(long long i)
+    {
+        Value v;
+        v.integer = i;
+        return v;
+    }
+
+    static Value string_value(const string &s)
+    {
+        Value v;
+        v.str = s;
+        return v;
+    }
+
+    static bool is_ascii(const string &s)
+    {
+        return all_of(s.begin(), s.end(), [](char c) {
+            return (c & 0x80) == 0;
+        });
+    }
+
+    /** Returns the number of characters (code points) of an UTF-8 string */
+    static size_t utf8_length(const string &s)
+    {
+        return count_if(s.begin(), s.end(), [](char c) {
+            return (c & 0xc0) != 0x80;
+        });
+    }
+
+    /** Returns the index of the first entry of the dict whose key isn't less
+     * than the given key */
+    static size_t dict_find(const Value &d, const Value &k, bool str)
+    {
+        size_t lo = 0, hi = d.items.size() / 2;
+
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            const Value &m = d.items[2 * mid];
+
+            if (str ? m.str < k.str : m.integer < k.integer)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    static bool dict_has(const Value &d, size_t i, const Value &k, bool str)
+    {
+        if (2 * i >= d.items.size())
+            return false;
+
+        const Value &m = d.items[2 * i];
+        return str ? m.str == k.str : m.integer == k.integer;
+    }
+
+    /** Maps the key to the value, replacing the value of an equal key */
+    static void dict_insert(Value &d, const Value &k, const Value &v,
+                            bool str)
+    {
+        size_t i = dict_find(d, k, str);
+
+        if (dict_has(d, i, k, str)) {
+            d.items[2 * i + 1] = v;
+        } else {
+            auto it = d.items.begin() + 2 * i;
+            it = d.items.insert(it, v);
+            d.items.insert(it, k);
+        }
+    }
+
+    static bool string_keys(const DictType *t)
+    {
+        return t->key() == TypeFactory::get("string");
+    }
+
+    static bool value_less(const Value &a, const Value &b, bool str)
+    {
+        return str ? a.str < b.str : a.integer < b.integer;
+    }
+
+    /** Returns a string that is equal for equal values, for hashing */
+    static string value_key(const Value &v)
+    {
+        string k = to_string(v.integer) + ":" + to_string(v.str.size()) +
+                   ":" + v.str + "(";
+
+        for (auto &i : v.items)
+            k += value_key(i);
+        return k + ")";
+    }
+
+    /** Returns the default value of a type, which is the value of the
+     * elements that are accessed out of range */
+    static Value default_value(const Type *t)
+    {
+        Value v;
+
+        if (t->record()) {
+            for (auto it = t->record()->begin(); it != t->record()->end(); ++it)
+                v.items.push_back(default_value(it->type));
+        }
+        return v;
+    }
+
+    /** Clamps a slice bound to [0, n], counting negative bounds from the
+     * end (as in Python) */
+    static size_t slice_bound(long long i, size_t n)
+    {
+        if (i < 0)
+            i += n;
+        return i < 0 ? 0 : min<long long>(i, n);
+    }
+
+    /** Folds the values of the lambda expression of an aggregation (e.g.
+     * sum()) to its result, which is of type t */
+    static Value aggregate(const string &name, const Value &l, const Type *t)
+    {
+        bool str = t == TypeFactory::get("string");
+        Value r = bool_value(name == "all");
+
+        for (size_t i = 0; i < l.items.size(); i++) {
+            const Value &v = l.items[i];
+
+            if (name == "sum")
+                r.integer += v.integer;
+            else if (name == "count")
+                r.integer += (v.integer != 0);
+            else if (name == "any")
+                r.integer = r.integer || v.integer;
+            else if (name == "all")
+                r.integer = r.integer && v.integer;
+            else if (i == 0 || (name == "min" ? value_less(v, r, str) :
+                                value_less(r, v, str)))
+                r = v;
+        }
+        return r;
+    }
+
+    /** Sorts the elements of a set and removes the duplicates */
+    static void set_normalize(Value &s, bool str)
+    {
+        auto less = [&](const Value &a, const Value &b) {
+            return value_less(a, b, str);
+        };
+        auto equal = [&](const Value &a, const Value &b) {
+            return !less(a, b) && !less(b, a);
+        };
+
+        stable_sort(s.items.begin(), s.items.end(), less);
+        s.items.erase(unique(s.items.begin(), s.items.end(), equal),
+                      s.items.end());
+    }
+
+    static size_t field_index(const RecordType *t, const string &name)
+    {
+        size_t i = 0;
+
+        for (auto it = t->begin(); it != t->end(); ++it, ++i) {
+            if ((*it).name == name)
+                return i;
+        }
+        throw NotStatic("no field " + name + " in " + t->str());
+    }
+
+    /** Converts constants to values */
+    class ValueBuilder : public ConstantDataVisitor
+    {
+        public:
+            ValueBuilder()
+                : value() {}
+
+            virtual void visit(const BoolConstantData *p) {
+                value = bool_value(p->value());
+            }
+
+            virtual void visit(const IntConstantData *p) {
+                value = int_value(p->value());
+            }
+
+            virtual void visit(const StringConstantData *p) {
+                value = string_value(p->value());
+            }
+
+            virtual void visit(const ListConstantData *p) {
+                Value l;
+
+                for (auto it = p->begin(); it != p->end(); ++it) {
+                    (*it)->accept(*this);
+                    l.items.push_back(value);
+                }
+                value = l;
+            }
+
+            virtual void visit(const RecordConstantData *p) {
+                Value r;
+
+                for (auto it = p->begin(); it != p->end(); ++it) {
+                    (*it)->accept(*this);
+                    r.items.push_back(value);
+                }
+                value = r;
+            }
+
+            virtual void visit(const SetConstantData *p) {
+                Value s;
+
+                for (auto it = p->begin(); it != p->end(); ++it) {
+                    (*it)->accept(*this);
+                    s.items.push_back(value);
+                }
+                set_normalize(s, p->type()->elem() ==
+                              TypeFactory::get("string"));
+                value = s;
+            }
+
+            virtual void visit(const DictConstantData *p) {
+                bool str = string_keys(p->type());
+                Value d;
+
+                for (auto it = p->begin(); it != p->end(); ++it) {
+                    it->first->accept(*this);
+                    Value k = value;
+                    it->second->accept(*this);
+                    dict_insert(d, k, value, str);
+                }
+                value = d;
+            }
+
+            Value value;
+    };
+
+    static Value constant_value(const ConstantData *d)
+    {
+        ValueBuilder b;
+        d->accept(b);
+        return b.value;
+    }
+
+    /** Evaluates a template body, following the semantics of the generated
+     * Python scripts */
+    class Renderer : public AST_Visitor
+    {
+        public:
+            Renderer(const map<symbol::Argument *, const ConstantData *> &a)
+                : out(), args_(a), env_(), value_(), memos_(),
+                  jump_(NONE) {}
+
+            using AST_Visitor::visit;
+
+            virtual void visit(TernaryIf *p) {
+                if (evaluate(p->condition()).integer)
+                    value_ = evaluate(p->if_true());
+                else
+                    value_ = evaluate(p->if_false());
+            }
+            virtual void visit(And *p) {
+                value_ = bool_value(evaluate(p->lhs()).integer &&
+                                    evaluate(p->rhs()).integer);
+            }
+            virtual void visit(Or *p) {
+                value_ = bool_value(evaluate(p->lhs()).integer ||
+                                    evaluate(p->rhs()).integer);
+            }
+            virtual void visit(Not *p) {
+                value_ = bool_value(!evaluate(p->expression()).integer);
+            }
+            virtual void visit(BoolEquals *p) {
+                value_ = bool_value(evaluate(p->lhs()).integer ==
+                                    evaluate(p->rhs()).integer);
+            }
+            virtual void visit(LessThan *p) {
+                value_ = bool_value(evaluate(p->lhs()).integer <
+                                    evaluate(p->rhs()).integer);
+            }
+            virtual void visit(LessThanOrEqual *p) {
+                value_ = bool_value(evaluate(p->lhs()).integer <=
+                                    evaluate(p->rhs()).integer);
+            }
+            virtual void visit(GreaterThan *p) {
+                value_ = bool_value(evaluate(p->lhs()).integer >
+                                    evaluate(p->rhs()).integer);
+            }
+            virtual void visit(GreaterThanOrEqual *p) {
+                value_ = bool_value(evaluate(p->lhs()).integer >=
+                                    evaluate(p->rhs()).integer);
+            }
+            virtual void visit(Equals *p) {
+                value_ = bool_value(evaluate(p->lhs()).integer ==
+                                    evaluate(p->rhs()).integer);
+            }
+            virtual void visit(Plus *p) {
+                long long r;
+                if (__builtin_add_overflow(evaluate(p->lhs()).integer,
+                                           evaluate(p->rhs()).integer, &r))
+                    throw NotStatic("integer overflow");
+                value_ = int_value(r);
+            }
+            virtual void visit(Minus *p) {
+                long long r;
+                if (__builtin_sub_overflow(evaluate(p->lhs()).integer,
+                                           evaluate(p->rhs()).integer, &r))
+                    throw NotStatic("integer overflow");
+                value_ = int_value(r);
+            }
+            virtual void visit(Times *p) {
+                long long r;
+                if (__builtin_mul_overflow(evaluate(p->lhs()).integer,
+                                           evaluate(p->rhs()).integer, &r))
+                    throw NotStatic("integer overflow");
+                value_ = int_value(r);
+            }
+            /* UTF-8 strings compare in code point order, as in Python */
+            virtual void visit(StringLessThan *p) {
+                value_ = bool_value(evaluate(p->lhs()).str <
+                                    evaluate(p->rhs()).str);
+            }
+            virtual void visit(StringLessThanOrEqual *p) {
+                value_ = bool_value(evaluate(p->lhs()).str <=
+                                    evaluate(p->rhs()).str);
+            }
+            virtual void visit(StringGreaterThan *p) {
+                value_ = bool_value(evaluate(p->lhs()).str >
+                                    evaluate(p->rhs()).str);
+            }
+            virtual void visit(StringGreaterThanOrEqual *p) {
+                value_ = bool_value(evaluate(p->lhs()).str >=
+                                    evaluate(p->rhs()).str);
+            }
+            virtual void visit(StringEquals *p) {
+                value_ = bool_value(evaluate(p->lhs()).str ==
+                                    evaluate(p->rhs()).str);
+            }
+            virtual void visit(StringRepeat *p) {
+                string s = evaluate(p->lhs()).str;
+                long long n = evaluate(p->rhs()).integer;
+                Value r;
+
+                if (n > 0 && s.size() * n > max_output)
+                    throw NotStatic("too large string");
+                for (long long i = 0; i < n; i++)
+                    r.str += s;
+                value_ = r;
+            }
+            virtual void visit(StringConcat *p) {
+                value_ = string_value(evaluate(p->lhs()).str +
+                                      evaluate(p->rhs()).str);
+            }
+            virtual void visit(ListConcat *p) {
+                Value l = evaluate(p->lhs());
+                Value r = evaluate(p->rhs());
+
+                l.items.insert(l.items.end(), r.items.begin(), r.items.end());
+                check_list(l);
+                value_ = l;
+            }
+            virtual void visit(Constant *p) {
+                value_ = constant_value(p->data());
+            }
+            virtual void visit(MethodCall *p);
+            virtual void visit(SymbolRef *p) {
+                symbol::Symbol *s = p->symbol();
+
+                if (s->argument()) {
+                    auto it = args_.find(s->argument());
+                    if (it == args_.end())
+                        throw NotStatic("unbound argument " + s->get_name());
+                    value_ = constant_value(it->second);
+                } else {
+                    auto it = env_.find(s);
+                    if (it == env_.end())
+                        throw NotStatic("unknown variable " + s->get_name());
+                    value_ = it->second;
+                }
+            }
+            virtual void visit(FieldRef *p) {
+                auto t = p->record()->type()->record();
+                Value r = evaluate(p->record());
+
+                value_ = r.items[field_index(t, p->field())];
+            }
+            virtual void visit(List *p) {
+                value_ = list(p->elements());
+                check_list(value_);
+            }
+            virtual void visit(Record *p) {
+                value_ = list(p->fields());
+            }
+            virtual void visit(Dict *p) {
+                bool str = string_keys(p->type());
+                auto v = p->values();
+                Value d;
+
+                for (auto k = p->keys(); k != nullptr; k = k->next) {
+                    Value key = evaluate(k->expression);
+                    dict_insert(d, key, evaluate(v->expression), str);
+                    v = v->next;
+                }
+                value_ = d;
+            }
+            virtual void visit(Pipeline *p);
+            virtual void visit(StringJoin *p) {
+                string s;
+
+                for (auto e = p->parts(); e != nullptr; e = e->next)
+                    s += evaluate(e->expression).str;
+                value_ = string_value(s);
+            }
+            virtual void visit(FunctionCall *p) {
+                if (p->name == "set") {
+                    value_ = evaluate(p->args->get_expression(0));
+                    set_normalize(value_, p->type()->set()->elem() ==
+                                  TypeFactory::get("string"));
+                    return;
+                } else if (p->name == "group_by") {
+                    value_ = group_by(p);
+                    return;
+                } else if (p->name == "reduce") {
+                    value_ = reduce(p);
+                    return;
+                } else if (p->name == "unique" || p->name == "distinct") {
+                    LambdaExpression *l = p->args->get_lambda(0);
+                    Value src = evaluate(p->args->get_expression(l ? 1 : 0));
+                    unordered_set<string> seen;
+                    Value r;
+
+                    for (auto &e : src.items) {
+                        if (seen.insert(value_key(l ? call(l, e) : e)).second)
+                            r.items.push_back(e);
+                    }
+                    value_ = r;
+                    return;
+                } else if (p->name == "zip") {
+                    Value a = evaluate(p->args->get_expression(0));
+                    Value b = evaluate(p->args->get_expression(1));
+                    Value r;
+
+                    for (size_t i = 0; i < a.items.size() &&
+                            i < b.items.size(); i++) {
+                        Value pair;
+
+                        pair.items.push_back(a.items[i]);
+                        pair.items.push_back(b.items[i]);
+                        r.items.push_back(pair);
+                    }
+                    value_ = r;
+                    return;
+                }
+
+                LambdaExpression *l = p->args->get_lambda(0);
+                Value src = evaluate(p->args->get_expression(1));
+                Value r;
+
+                for (auto &e : src.items) {
+                    Value v = call(l, e);
+
+                    if (p->aggregation())
+                        r.items.push_back(v);
+                    else if (p->name == "index_by")
+                        dict_insert(r, v, e, string_keys(p->type()->dict()));
+                    else if (p->name == "map")
+                        r.items.push_back(v);
+                    else if (p->name == "filter" && v.integer)
+                        r.items.push_back(e);
+                    else if (p->name != "filter" && p->name != "index_by")
+                        throw NotStatic("unknown function " + p->name);
+                }
+                if (p->aggregation())
+                    r = aggregate(p->name, r, p->type());
+                value_ = r;
+            }
+
+            virtual void visit(Statements *p) {
+                for (auto s = p; s != nullptr && jump_ == NONE; s = s->next())
+                    s->statement()->accept(*this);
+            }
+            virtual void visit(Conditional *p) {
+                if (evaluate(p->if_node()->condition()).integer) {
+                    block(p->if_node()->statements());
+                    return;
+                }
+                for (Elif *e = p->elif_nodes(); e != nullptr; e = e->next()) {
+                    if (evaluate(e->condition()).integer) {
+                        block(e->statements());
+                        return;
+                    }
+                }
+                if (p->else_node())
+                    block(p->else_node()->statements());
+            }
+            virtual void visit(ForEach *p) {
+                Value l = evaluate(p->expression());
+                long long n = l.items.size();
+
+                for (long long i = 0; i < n; i++) {
+                    Value loop;
+
+                    loop.items.push_back(int_value(i));
+                    loop.items.push_back(bool_value(i == 0));
+                    loop.items.push_back(bool_value(i == n - 1));
+                    loop.items.push_back(int_value(n));
+
+                    env_[p->variable()] = l.items[i];
+                    env_[p->loop_variable()] = loop;
+                    block(p->statements());
+                    if (next_iteration())
+                        break;
+                }
+            }
+            virtual void visit(ForEachEnum *p) {
+                Value l = evaluate(p->expression());
+
+                for (size_t i = 0; i < l.items.size(); i++) {
+                    env_[p->index()] = int_value(i);
+                    env_[p->value()] = l.items[i];
+                    block(p->statements());
+                    if (next_iteration())
+                        break;
+                }
+            }
+            virtual void visit(If *) {}
+            virtual void visit(Elif *) {}
+            virtual void visit(Else *) {}
+            virtual void visit(Text *p) {
+                write(p->text());
+            }
+            virtual void visit(InlinedExpression *p) {
+                write(evaluate(p->expression()).str);
+            }
+            virtual void visit(VariableList *p) {
+                for (auto v = p; v != nullptr; v = v->next)
+                    v->statement->accept(*this);
+            }
+            virtual void visit(VariableDeclaration *p) {
+                if (p->assignment()) {
+                    p->assignment()->accept(*this);
+                } else {
+                    ConstantData *d = create_default_constant(
+                        p->variable()->get_type());
+                    env_[p->variable()] = constant_value(d);
+                    delete d;
+                }
+            }
+            virtual void visit(VariableAssignment *p) {
+                env_[p->variable()] = evaluate(p->expression());
+            }
+            virtual void visit(Create *) {
+                throw NotStatic("create() can't be rendered");
+            }
+            virtual void visit(Macro *) {}
+            virtual void visit(MacroCall *p) {
+                Macro *m = p->macro();
+                auto a = p->arguments();
+
+                for (auto v : m->params()) {
+                    env_[v] = evaluate(a->expression);
+                    a = a->next;
+                }
+                block(m->statements());
+            }
+            virtual void visit(Memo *p) {
+                auto &cache = memos_[p];
+                string key = value_key(evaluate(p->key()));
+                auto it = cache.find(key);
+
+                if (it != cache.end()) {
+                    write(it->second);
+                } else {
+                    size_t start = out.size();
+                    block(p->statements());
+                    cache[key] = out.substr(start);
+                }
+            }
+            virtual void visit(Break *) {
+                jump_ = BREAK;
+            }
+            virtual void visit(Continue *) {
+                jump_ = CONTINUE;
+            }
+
+            string out;
+        private:
+            Renderer(const Renderer &) = delete;
+            Renderer &operator=(const Renderer &) = delete;
+
+            Value evaluate(Expression *e) {
+                e->accept(*this);
+                return value_;
+            }
+
+            Value list(ExpressionList *l) {
+                Value r;
+
+                for (auto e = l; e != nullptr; e = e->next)
+                    r.items.push_back(evaluate(e->expression));
+                return r;
+            }
+
+            Value call(LambdaExpression *l, const Value &arg) {
+                env_[l->variables->statement->variable()] = arg;
+                return evaluate(l->expression);
+            }
+
+            void block(Statements *s) {
+                if (s)
+                    s->accept(*this);
+            }
+
+            /** Ends an iteration of a loop. Returns true if the loop is left
+             * by a break */
+            bool next_iteration() {
+                bool left = jump_ == BREAK;
+
+                jump_ = NONE;
+                return left;
+            }
+
+            void write(const string &s) {
+                out += s;
+                if (out.size() > max_output)
+                    throw NotStatic("too large output");
+            }
+
+            void check_list(const Value &l) {
+                if (l.items.size() > max_list)
+                    throw NotStatic("too large list");
+            }
+
+            void sort(Value &, ExpressionList *, const Type *elem);
+            void dict_method(const string &, const Value &, const Value &,
+                             const DictType *);
+            void set_method(const string &, const Value &, const Value &,
+                            const SetType *);
+            Value group_by(FunctionCall *);
+            Value reduce(FunctionCall *);
+            Value to_str(const Value &, const Type *);
+
+            const map<symbol::Argument *, const ConstantData *> &args_;
+            map<symbol::Symbol *, Value> env_;
+            Value value_;
+            /* The output of each memo block, by key */
+            map<Memo *, map<string, string>> memos_;
+            /* Set by a break or continue until the loop is reached, which
+             * skips the rest of the statements in between */
+            enum { NONE, BREAK, CONTINUE } jump_;
+    };
+
+    void Renderer::visit(MethodCall *p)
+    {
+        auto t = p->expression()->type();
+        auto name = p->method().name();
+        Value e = evaluate(p->expression());
+        Value a0, a1;
+
+        if (p->arguments()) {
+            a0 = evaluate(p->arguments()->expression);
+            if (p->arguments()->next)
+                a1 = evaluate(p->arguments()->next->expression);
+        }
+
+        if (t->dict()) {
+            dict_method(name, e, a0, t->dict());
+        } else if (t->set()) {
+            set_method(name, e, a0, t->set());
+        } else if (name == "str") {
+            value_ = to_str(e, t);
+        } else if (name == "downto" || name == "upto") {
+            long long from = (name == "upto") ? e.integer : a0.integer;
+            long long to = (name == "upto") ? a0.integer : e.integer;
+            Value r;
+
+            if (to - from >= (long long)max_list)
+                throw NotStatic("too large list");
+            for (long long i = from; i <= to; i++)
+                r.items.push_back(int_value(i));
+            if (name == "downto")
+                reverse(r.items.begin(), r.items.end());
+            value_ = r;
+        } else if (name == "lalign" || name == "ralign") {
+            size_t n = utf8_length(e.str);
+
+            if (a0.integer > (long long)max_output)
+                throw NotStatic("too large string");
+            if (a0.integer > (long long)n) {
+                string pad(a0.integer - n, ' ');
+                e.str = (name == "lalign") ? e.str + pad : pad + e.str;
+            }
+            value_ = e;
+        } else if (name == "length") {
+            value_ = int_value(utf8_length(e.str));
+        } else if (name == "lower" || name == "upper" || name == "title") {
+            /* Python's case mappings of non-ASCII characters are left to
+             * the script */
+            if (!is_ascii(e.str))
+                throw NotStatic(name + "() of a non-ASCII string");
+
+            bool cased = false;
+            for (auto &c : e.str) {
+                bool alpha = isalpha(c);
+
+                if (name == "upper" || (name == "title" && !cased))
+                    c = toupper(c);
+                else
+                    c = tolower(c);
+                cased = alpha;
+            }
+            value_ = e;
+        } else if (name == "replace") {
+            if (a0.str.empty())
+                throw NotStatic("replace() of an empty string");
+
+            string r;
+            size_t pos = 0, next;
+
+            while ((next = e.str.find(a0.str, pos)) != string::npos) {
+                r += e.str.substr(pos, next - pos) + a1.str;
+                pos = next + a0.str.size();
+            }
+            value_ = string_value(r + e.str.substr(pos));
+        } else if (name == "elems") {
+            auto r = t->record();
+            auto f = r->begin();
+            Value l;
+
+            for (auto it = e.items.begin(); it != e.items.end(); ++it, ++f)
+                l.items.push_back(to_str(*it, (*f).type));
+            value_ = l;
+        } else if (name == "at") {
+            long long n = e.items.size();
+            long long i = a0.integer < 0 ? a0.integer + n : a0.integer;
+
+            if (i >= 0 && i < n)
+                value_ = e.items[i];
+            else
+                value_ = default_value(t->list()->elem());
+        } else if (name == "from" || name == "slice") {
+            size_t from = slice_bound(a0.integer, e.items.size());
+            size_t to = (name == "from") ? e.items.size() :
+                        slice_bound(a1.integer, e.items.size());
+            Value l;
+
+            if (from < to)
+                l.items.assign(e.items.begin() + from, e.items.begin() + to);
+            value_ = l;
+        } else if (name == "size") {
+            value_ = int_value(e.items.size());
+        } else if (name == "sort" || name == "sort_by") {
+            sort(e, p->arguments(), t->list()->elem());
+            value_ = e;
+        } else if (name == "join") {
+            string r;
+
+            for (auto it = e.items.begin(); it != e.items.end(); ++it) {
+                if (it != e.items.begin())
+                    r += a0.str;
+                r += it->str;
+            }
+            value_ = string_value(r);
+        } else {
+            throw NotStatic(name + "() can't be rendered");
+        }
+    }
+
+    void Renderer::dict_method(const string &name, const Value &d,
+                               const Value &k, const DictType *t)
+    {
+        bool str = string_keys(t);
+        Value l;
+
+        if (name == "get" || name == "has") {
+            size_t i = dict_find(d, k, str);
+            bool found = dict_has(d, i, k, str);
+
+            /* A missing key is an error that is left to the script */
+            if (name == "has")
+                value_ = bool_value(found);
+            else if (found)
+                value_ = d.items[2 * i + 1];
+            else
+                throw NotStatic("get() of a missing key");
+        } else if (name == "keys" || name == "values") {
+            size_t first = (name == "keys") ? 0 : 1;
+
+            for (size_t i = first; i < d.items.size(); i += 2)
+                l.items.push_back(d.items[i]);
+            value_ = l;
+        } else if (name == "size") {
+            value_ = int_value(d.items.size() / 2);
+        } else {
+            throw NotStatic(name + "() can't be rendered");
+        }
+    }
+
+    void Renderer::set_method(const string &name, const Value &s,
+                              const Value &a, const SetType *t)
+    {
+        bool str = t->elem() == TypeFactory::get("string");
+        auto less = [&](const Value &x, const Value &y) {
+            return value_less(x, y, str);
+        };
+        Value r;
+
+        if (name == "has") {
+            value_ = bool_value(binary_search(s.items.begin(), s.items.end(),
+                                              a, less));
+        } else if (name == "size") {
+            value_ = int_value(s.items.size());
+        } else if (name == "list") {
+            value_ = s;
+        } else if (name == "union") {
+            set_union(s.items.begin(), s.items.end(), a.items.begin(),
+                      a.items.end(), back_inserter(r.items), less);
+            check_list(r);
+            value_ = r;
+        } else if (name == "intersection") {
+            set_intersection(s.items.begin(), s.items.end(), a.items.begin(),
+                             a.items.end(), back_inserter(r.items), less);
+            value_ = r;
+        } else if (name == "difference") {
+            set_difference(s.items.begin(), s.items.end(), a.items.begin(),
+                           a.items.end(), back_inserter(r.items), less);
+            value_ = r;
+        } else {
+            throw NotStatic(name + "() can't be rendered");
+        }
+    }
+
+    Value Renderer::group_by(FunctionCall *p)
+    {
+        LambdaExpression *l = p->args->get_lambda(0);
+        Value src = evaluate(p->args->get_expression(1));
+        auto group = p->type()->list()->elem()->record();
+        bool str = group->begin()->type == TypeFactory::get("string");
+        map<pair<long long, string>, size_t> index;
+        Value r;
+
+        for (auto &e : src.items) {
+            Value k = call(l, e);
+            auto key = str ? make_pair(0LL, k.str) : make_pair(k.integer, string());
+            auto it = index.find(key);
+
+            if (it == index.end()) {
+                Value g;
+
+                g.items.push_back(k);
+                g.items.push_back(Value());
+                it = index.insert(make_pair(key, r.items.size())).first;
+                r.items.push_back(g);
+            }
+            r.items[it->second].items[1].items.push_back(e);
+        }
+        return r;
+    }
+
+    Value Renderer::reduce(FunctionCall *p)
+    {
+        LambdaExpression *l = p->args->get_lambda(0);
+        Value src = evaluate(p->args->get_expression(1));
+        Value r = evaluate(p->args->get_expression(2));
+
+        for (auto &e : src.items) {
+            env_[l->variables->statement->variable()] = r;
+            env_[l->variables->next->statement->variable()] = e;
+            r = evaluate(l->expression);
+        }
+        return r;
+    }
+
+    void Renderer::visit(Pipeline *p)
+    {
+        Value src = evaluate(p->source());
+        Value l;
+
+        for (auto &e : src.items) {
+            Value v = e;
+            bool keep = true;
+
+            for (auto &s : p->stages()) {
+                Value r = call(s.lambda, v);
+
+                if (s.kind == Pipeline::MAP) {
+                    v = r;
+                } else if (!r.integer) {
+                    keep = false;
+                    break;
+                }
+            }
+            if (keep)
+                l.items.push_back(v);
+        }
+
+        if (p->sort()) {
+            const Type *elem = p->source()->type()->list()->elem();
+
+            for (auto &s : p->stages()) {
+                if (s.kind == Pipeline::MAP)
+                    elem = s.lambda->expression->type();
+            }
+            sort(l, p->sort(), elem);
+        }
+
+        if (p->reduce() == "size") {
+            value_ = int_value(l.items.size());
+        } else if (p->reduce() == "join") {
+            string sep = evaluate(p->reduce_arguments()->expression).str;
+            string r;
+
+            for (auto it = l.items.begin(); it != l.items.end(); ++it) {
+                if (it != l.items.begin())
+                    r += sep;
+                r += it->str;
+            }
+            value_ = string_value(r);
+        } else if (!p->reduce().empty()) {
+            value_ = aggregate(p->reduce(), l, p->type());
+        } else {
+            value_ = l;
+        }
+    }
+
+    void Renderer::sort(Value &l, ExpressionList *args, const Type *elem)
+    {
+        struct Key
+        {
+            size_t field;
+            bool str;
+            bool asc;
+        };
+        vector<Key> keys;
+
+        if (elem->record()) {
+            /* (field, ascending) pairs, the first one is the most
+             * significant */
+            for (auto a = args; a != nullptr; a = a->next->next) {
+                size_t field = field_index(elem->record(),
+                                           evaluate(a->expression).str);
+                const Type *t = elem->record()->begin()[field].type;
+
+                if (!t->primitive())
+                    throw NotStatic("sort() by a list field");
+                keys.push_back({ field, t == TypeFactory::get("string"),
+                                 evaluate(a->next->expression).integer != 0 });
+            }
+        } else {
+            keys.push_back({ 0, elem == TypeFactory::get("string"),
+                             evaluate(args->expression).integer != 0 });
+        }
+
+        auto less = [&](const Value &a, const Value &b) {
+            for (auto &k : keys) {
+                const Value &x = elem->record() ? a.items[k.field] : a;
+                const Value &y = elem->record() ? b.items[k.field] : b;
+
+                if (value_less(x, y, k.str))
+                    return k.asc;
+                if (value_less(y, x, k.str))
+                    return !k.asc;
+            }
+            return false;
+        };
+
+        /* sorted(reverse=True) keeps the order of equal elements */
+        stable_sort(l.items.begin(), l.items.end(), less);
+    }
+
+    Value Renderer::to_str(const Value &v, const Type *t)
+    {
+        if (t == TypeFactory::get("bool"))
+            return string_value(v.integer ? "true" : "false");
+        else if (t == TypeFactory::get("int"))
+            return string_value(to_string(v.integer));
+        else if (t == TypeFactory::get("string"))
+            return v;
+        throw NotStatic("str() of " + t->str());
+    }
+
+    bool render(Statements *body,
+                const map<symbol::Argument *, const ConstantData *> &args,
+                string &out)
+    {
+        Renderer r(args);
+
+        try {
+            if (body)
+                body->accept(r);
+        } catch (const NotStatic &) {
+            return false;
+        }
+
+        out = r.out;
+        return true;
+    }
+
+    Statements *StaticRendering::rewrite_block(Statements *p)
+    {
+        string out;
+
+        if (!render(p, map<symbol::Argument *, const ConstantData *>(), out))
+            return p;
+        return out.empty() ? nullptr : new Statements(new Text(out));
+    }
+
+    /** Renders the create() calls with constant keyword arguments */
+    class CreateRenderer : public AST_Rewriter
+    {
+        public:
+            CreateRenderer(symbol::SymbolTable *t,
+                           const map<string, ParseData *> &tgl)
+                : AST_Rewriter(t), tgl_(tgl) {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(Create *p) {
+                auto it = tgl_.find(p->tgl);
+                map<symbol::Argument *, const ConstantData *> args;
+
+                if (it == tgl_.end())
+                    return;
+
+                for (auto a : it->second->arguments) {
+                    auto kw = p->args.find(a->get_name());
+
+                    if (kw == p->args.end())
+                        args[a] = a->get("default")->get();
+                    else if (kw->second->constant())
+                        args[a] = kw->second->constant()->data();
+                    else
+                        return;
+                }
+
+                p->rendered = render(it->second->body, args, p->text);
+            }
+        private:
+            CreateRenderer(const CreateRenderer &) = delete;
+            CreateRenderer &operator=(const CreateRenderer &) = delete;
+
+            const map<string, ParseData *> &tgl_;
+    };
+
+    void render_creates(ParseData *tgp, const map<string, ParseData *> &tgl)
+    {
+        if (tgp->body) {
+            CreateRenderer r(tgp->root_table, tgl);
+            tgp->body = r.rewrite_block(tgp->body);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include <map>
+#include <stdexcept>
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** Thrown when a template can't be rendered at compile time */
+    class NotStatic : public runtime_error
+    {
+        public:
+            NotStatic(const string &s)
+                : runtime_error(s) {}
+    };
+
+    /** Renders a template body at compile time, i.e. evaluates it the same
+     * way as the generated script would
+     *
+     * @param body the statements to render
+     * @param args the values of the arguments (references to arguments that
+     * are not in the map makes the rendering fail)
+     * @param out the rendered text
+     * @return true if the body could be rendered. The rendering fails if the
+     * body depends on anything that isn't known at compile time, or uses
+     * something that the renderer can't evaluate exactly as the scripts
+     * (e.g. wrap())
+     */
+    bool render(Statements *body,
+                const map<symbol::Argument *, const ConstantData *> &args,
+                string &out);
+
+    /** StaticRendering class
+     *
+     * Renders the whole body of a file at compile time, if it doesn't depend
+     * on any arguments, and replaces it with the rendered text. The generated
+     * script then only writes a single string.
+     */
+    class StaticRendering : public AST_Rewriter
+    {
+        public:
+            StaticRendering(symbol::SymbolTable *t)
+                : AST_Rewriter(t) {}
+
+            virtual Statements *rewrite_block(Statements *);
+    };
+
+    /** Renders the files of the create() calls in a .tgp body that only has
+     * constant keyword arguments */
+    void render_creates(ParseData *tgp, const map<string, ParseData *> &tgl);
+}
+
+#endif
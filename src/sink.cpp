@@ -0,0 +1,219 @@
+#include <vector>
+
+#include "sink.hpp"
+
+namespace optimizer {
+
+    /** The symbols that are referenced and the variables that are assigned
+     * by statements */
+    struct Uses
+    {
+        Uses()
+            : used(), assigned() {}
+
+        set<symbol::Symbol *> used;
+        set<symbol::Symbol *> assigned;
+
+        bool mentions(symbol::Symbol *s) const {
+            return used.count(s) || assigned.count(s);
+        }
+
+        void add(const Uses &u) {
+            used.insert(u.used.begin(), u.used.end());
+            assigned.insert(u.assigned.begin(), u.assigned.end());
+        }
+    };
+
+    /** Collects the uses of statements */
+    class UseCollector : public AST_Rewriter
+    {
+        public:
+            UseCollector()
+                : AST_Rewriter(nullptr), uses() {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(SymbolRef *p) {
+                uses.used.insert(p->symbol());
+            }
+
+            virtual void visit(VariableAssignment *p) {
+                uses.assigned.insert(p->variable());
+                AST_Rewriter::visit(p);
+            }
+
+            Uses uses;
+    };
+
+    template<typename T>
+    static Uses uses_of(T *p)
+    {
+        UseCollector c;
+
+        if (p)
+            p->accept(c);
+        return c.uses;
+    }
+
+    /** Returns the branch of the conditional that is the only part of it
+     * that mentions the variable, or nullptr if there's no such branch */
+    static Scope *only_branch(Conditional *c, symbol::Symbol *v)
+    {
+        vector<Expression *> conditions = { c->if_node()->condition() };
+        vector<Scope *> branches = { c->if_node() };
+
+        for (Elif *e = c->elif_nodes(); e != nullptr; e = e->next()) {
+            conditions.push_back(e->condition());
+            branches.push_back(e);
+        }
+        if (c->else_node())
+            branches.push_back(c->else_node());
+        if (c->dispatch_subject())
+            conditions.push_back(c->dispatch_subject());
+
+        for (auto e : conditions) {
+            if (free_symbols(e).count(v))
+                return nullptr;
+        }
+
+        Scope *found = nullptr;
+
+        for (auto b : branches) {
+            if (!uses_of(b->statements()).mentions(v))
+                continue;
+            if (found)
+                return nullptr;
+            found = b;
+        }
+        return found;
+    }
+
+    Statements *BindingSinking::rewrite_block(Statements *p)
+    {
+        vector<Statements *> block;
+        vector<Uses> uses;
+
+        for (auto s = p; s != nullptr; s = s->next()) {
+            block.push_back(s);
+            uses.push_back(uses_of(s->statement()));
+        }
+
+        /* The block is walked backwards, so that the declarations that a
+         * removed or moved declaration used are handled after it */
+        for (size_t i = block.size(); i-- > 0; ) {
+            VariableList *l = block[i]->statement()->variable_list();
+
+            if (!l)
+                continue;
+
+            int line = l->line();
+            vector<VariableList *> elems;
+
+            for (auto e = l; e != nullptr; e = e->next)
+                elems.push_back(e);
+
+            for (size_t k = elems.size(); k-- > 0; ) {
+                VariableDeclaration *d = elems[k]->statement->declaration();
+
+                if (!d || !d->assignment())
+                    continue;
+
+                auto v = d->variable();
+
+                /* The uses between the declaration and the first statement
+                 * that mentions the variable */
+                Uses between;
+
+                for (size_t m = k + 1; m < elems.size(); m++) {
+                    if (elems[m])
+                        between.add(uses_of(elems[m]->statement));
+                }
+                if (between.mentions(v))
+                    continue;
+
+                size_t j = i + 1;
+
+                while (j < block.size() && !uses[j].mentions(v))
+                    between.add(uses[j++]);
+
+                VariableList *moved = elems[k];
+
+                if (j == block.size()) {
+                    /* The variable is never used */
+                    elems[k] = nullptr;
+                    moved->next = nullptr;
+                    delete moved;
+                    continue;
+                }
+
+                bool once = true;
+
+                for (size_t m = j + 1; m < block.size(); m++)
+                    once = once && !uses[m].mentions(v);
+
+                Conditional *c = block[j]->statement()->conditional();
+                Scope *b = once && c ? only_branch(c, v) : nullptr;
+
+                if (!b)
+                    continue;
+
+                bool changed = false;
+
+                for (auto s : free_symbols(d->assignment()->expression()))
+                    changed = changed || between.assigned.count(s);
+
+                if (changed)
+                    continue;
+
+                elems[k] = nullptr;
+                moved->next = nullptr;
+                moved->set_line(line);
+                b->set_statements(new Statements(moved, b->statements()));
+                uses[j].add(uses_of(moved));
+            }
+
+            /* Relink the remaining declarations */
+            VariableList *head = nullptr, *last = nullptr;
+
+            for (auto e : elems) {
+                if (!e)
+                    continue;
+                if (last)
+                    last->next = e;
+                else
+                    head = e;
+                last = e;
+            }
+
+            if (last) {
+                last->next = nullptr;
+                head->set_line(line);
+                block[i]->set_statement(head);
+                uses[i] = uses_of(head);
+            } else {
+                block[i]->set_statement(nullptr);
+                uses[i] = Uses();
+            }
+        }
+
+        /* Unlink the emptied statements */
+        Statements *head = nullptr, *last = nullptr;
+
+        for (auto s : block) {
+            if (!s->statement()) {
+                s->set_next(nullptr);
+                delete s;
+                continue;
+            }
+            if (last)
+                last->set_next(s);
+            else
+                head = s;
+            last = s;
+        }
+        if (last)
+            last->set_next(nullptr);
+
+        return AST_Rewriter::rewrite_block(head);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef __SINK_H__
+#define __SINK_H__
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** BindingSinking class
+     *
+     * Removes with-declarations whose variable is never used, and moves
+     * declarations whose variable is only used in one branch of a later
+     * conditional statement into that branch:
+     *
+     *   ~~~
+     *   % with string guard = name.upper().replace(".", "_") + "_H"
+     *   % if header
+     *   #ifndef {{ guard }}
+     *   % endif
+     *   ~~~
+     *
+     * is rewritten to
+     *
+     *   ~~~
+     *   % if header
+     *   % with string guard = name.upper().replace(".", "_") + "_H"
+     *   #ifndef {{ guard }}
+     *   % endif
+     *   ~~~
+     *
+     * so that the value is only computed when the branch is taken.
+     *
+     * @details A declaration is only moved if nothing that its value depends
+     * on is assigned between the declaration and the conditional. It's never
+     * moved into a loop, where it would be computed once per iteration.
+     */
+    class BindingSinking : public AST_Rewriter
+    {
+        public:
+            BindingSinking(symbol::SymbolTable *t)
+                : AST_Rewriter(t) {}
+
+            virtual Statements *rewrite_block(Statements *);
+    };
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include <sstream>
+
+#include "binding.hpp"
+#include "specialize.hpp"
+
+namespace optimizer {
+
+    /** Redirects create() calls to specialized copies of their files */
+    class CreateSpecializer : public AST_Rewriter
+    {
+        public:
+            CreateSpecializer(symbol::SymbolTable *t,
+                              map<string, ParseData *> &tgl, FileParser parse)
+                : AST_Rewriter(t), used(), tgl_(tgl), parse_(parse),
+                  copies_(), count_() {}
+
+            using AST_Rewriter::visit;
+
+            virtual void visit(Create *p) {
+                redirect(p);
+                used.insert(p->tgl);
+            }
+
+            /* The files that are still created by the body */
+            set<string> used;
+        private:
+            CreateSpecializer(const CreateSpecializer &) = delete;
+            CreateSpecializer &operator=(const CreateSpecializer &) = delete;
+
+            /** Lets the call create a specialized copy of its file, if it
+             * has constant arguments */
+            void redirect(Create *p) {
+                auto it = tgl_.find(p->tgl);
+                map<string, const ConstantData *> bound;
+                stringstream key;
+
+                if (it == tgl_.end())
+                    return;
+
+                /* Only bind the arguments that the file uses, to not create
+                 * copies that are identical to the original */
+                key << p->tgl;
+                for (auto a : it->second->arguments) {
+                    auto kw = p->args.find(a->get_name());
+                    const ConstantData *c = nullptr;
+
+                    if (kw == p->args.end())
+                        c = a->get("default")->get();
+                    else if (kw->second->constant())
+                        c = kw->second->constant()->data();
+
+                    if (c && record_usage(it->second->body, a).used()) {
+                        bound[a->get_name()] = c;
+                        key << ":" << a->get_name() << "=" << *c;
+                    }
+                }
+
+                if (bound.empty())
+                    return;
+
+                auto copy = copies_.find(key.str());
+
+                if (copy == copies_.end()) {
+                    string name = specialize(p->tgl, bound);
+
+                    if (name.empty())
+                        return;
+                    copy = copies_.insert(make_pair(key.str(), name)).first;
+                }
+
+                p->tgl = copy->second;
+                for (auto &b : bound)
+                    p->args.erase(b.first);
+            }
+
+            /** Parses a copy of the file, binds the arguments and adds the
+             * copy to the files. Returns the name of the copy */
+            string specialize(const string &file,
+                              const map<string, const ConstantData *> &b) {
+                ParseData *data = parse_(file);
+                map<symbol::Argument *, ConstantData *> bindings;
+
+                if (data == nullptr)
+                    return "";
+
+                for (auto a : data->arguments) {
+                    auto it = b.find(a->get_name());
+                    if (it != b.end())
+                        bindings[a] = copy_constant(it->second);
+                }
+                bind_arguments(data, bindings);
+
+                string name = file + "#" + to_string(++count_[file]);
+                tgl_[name] = data;
+                return name;
+            }
+
+            map<string, ParseData *> &tgl_;
+            FileParser parse_;
+            map<string, string> copies_;
+            map<string, unsigned> count_;
+    };
+
+    void specialize_creates(ParseData *tgp, map<string, ParseData *> &tgl,
+                            FileParser parse)
+    {
+        if (tgp->body) {
+            CreateSpecializer s(tgp->root_table, tgl, parse);
+            tgp->body = s.rewrite_block(tgp->body);
+
+            /* Drop the files that are only generated through copies */
+            for (auto it = tgl.begin(); it != tgl.end(); ) {
+                if (s.used.count(it->first))
+                    ++it;
+                else
+                    it = tgl.erase(it);
+            }
+        }
+    }
+}
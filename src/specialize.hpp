@@ -0,0 +1,26 @@
+#ifndef __SPECIALIZE_H__
+#define __SPECIALIZE_H__
+
+#include <map>
+
+#include "optimizer.hpp"
+
+namespace optimizer {
+
+    /** Parses a file and returns its data (or nullptr on errors). Used to
+     * get fresh copies of the syntax trees of .tgl files */
+    typedef ParseData *(*FileParser)(const string &);
+
+    /** Specializes the .tgl files of the create() calls in a .tgp body
+     *
+     * The arguments of a .tgl file that a create() call gives a constant
+     * value (explicitly or by leaving out the keyword) are bound to the
+     * constants in a copy of the file, which the call then generates
+     * instead. Calls with the same constant arguments share the copy. The
+     * copies are added to the files as "<file>#<n>".
+     */
+    void specialize_creates(ParseData *tgp, map<string, ParseData *> &tgl,
+                            FileParser parse);
+}
+
+#endif
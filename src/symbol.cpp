@@ -88,6 +88,13 @@ namespace symbol {
             throw SymTabNoSuchSymbolError(s);
     }
 
+    bool SymbolTable::contains(Symbol *s) const
+    {
+        auto it = map_.find(s->get_name());
+
+        return (it != map_.end() && it->second == s);
+    }
+
     void SymbolTable::print(ostream &os) const
     {
         for (auto it = map_.begin(); it != map_.end(); it++) {
@@ -191,6 +191,9 @@ namespace symbol {
 
             void add(Symbol *s);
             Symbol *lookup(const string &);
+            /** Returns true if the symbol is defined in this table (the
+             * parent tables are not searched) */
+            bool contains(Symbol *s) const;
             void print(ostream &os) const;
             SymbolTable *parent() {
                 return parent_;
@@ -30,17 +30,45 @@ namespace type {
         return nullptr;
     }
 
+    const DictType *Type::dict() const
+    {
+        return nullptr;
+    }
+
+    const SetType *Type::set() const
+    {
+        return nullptr;
+    }
+
     void Type::add_method(const TypeMethod &tm)
     {
         methods_[tm.name()] = tm;
     }
 
+    /** Checks the arguments of a method with repeated parameters */
+    static TypeMethod lookup_repeated(const TypeMethod &m,
+                                      const vector<const Type *> &p)
+    {
+        auto params = m.parameters();
+        bool match = !p.empty() && p.size() % params.size() == 0;
+
+        for (size_t i = 0; match && i < p.size(); i++)
+            match = (p[i] == params[i % params.size()]);
+
+        if (!match)
+            throw WrongArgumentSignatureError(types_to_str(p),
+                                              types_to_str(params) + ", ...");
+        return m;
+    }
+
     TypeMethod Type::lookup(const string &s, const vector<const Type *> &p) const
     {
         auto it = methods_.find(s);
 
         if (it == methods_.end())
             throw NoSuchMethodError(str(), s);
+        if (it->second.repeated())
+            return lookup_repeated(it->second, p);
         if (p.size() != it->second.no_of_parameters())
             throw WrongNumberOfArgumentsError(p.size(),
                                               it->second.no_of_parameters());
@@ -63,7 +91,8 @@ namespace type {
 
             os << "\t" << m.return_type()->str() << " "
                << m.name() << "(" <<
-               types_to_str(m.parameters()) << ")\n";
+               types_to_str(m.parameters()) <<
+               (m.repeated() ? ", ..." : "") << ")\n";
         }
     }
 
@@ -72,7 +101,7 @@ namespace type {
         os << "PrimitiveType(" << str() << ")";
     }
 
-    const PrimitiveType *RecordType::dot(const string &f) const
+    const Type *RecordType::dot(const string &f) const
     {
         auto it = find_if(fields_.begin(), fields_.end(),
         [&] (const RecordField &r) {
@@ -143,11 +172,28 @@ namespace type {
         return true;
     }
 
+    bool RecordType::flat() const
+    {
+        return all_of(begin(), end(), [](const RecordField &f) {
+            return f.type->primitive() != nullptr;
+        });
+    }
+
     void ListType::print(ostream &os) const
     {
         os << "ListType(" << str() << ")";
     }
 
+    void DictType::print(ostream &os) const
+    {
+        os << "DictType(" << str() << ")";
+    }
+
+    void SetType::print(ostream &os) const
+    {
+        os << "SetType(" << str() << ")";
+    }
+
     string types_to_str(const vector<const Type *> &v)
     {
         auto it = v.begin();
@@ -26,6 +26,8 @@ namespace type {
     class StringType;
     class RecordType;
     class ListType;
+    class DictType;
+    class SetType;
 
     /** Type Method class
      *
@@ -36,10 +38,11 @@ namespace type {
     {
         public:
             TypeMethod(const string &name, const Type *rt,
-                       vector<const Type *> &params)
-                : name_(name), return_(rt), params_(params) {}
+                       vector<const Type *> &params, bool repeated = false)
+                : name_(name), return_(rt), params_(params),
+                  repeated_(repeated) {}
             TypeMethod()
-                : name_(""), return_(nullptr), params_() {}
+                : name_(""), return_(nullptr), params_(), repeated_(false) {}
             TypeMethod(const TypeMethod &) = default;
             TypeMethod &operator=(const TypeMethod &) = default;
 
@@ -55,10 +58,17 @@ namespace type {
             size_t no_of_parameters() const {
                 return params_.size();
             }
+
+            /** Returns true if the parameters can be repeated, i.e. if the
+             * method takes one or more groups of the parameters */
+            bool repeated() const {
+                return repeated_;
+            }
         private:
             string name_;
             const Type *return_;
             vector<const Type *> params_;
+            bool repeated_;
     };
 
     class NoSuchMethodError : public runtime_error
@@ -99,6 +109,8 @@ namespace type {
             virtual void visit(const StringType *) = 0;
             virtual void visit(const ListType *) = 0;
             virtual void visit(const RecordType *) = 0;
+            virtual void visit(const DictType *) = 0;
+            virtual void visit(const SetType *) = 0;
     };
 
     /** Abstract type class
@@ -158,6 +170,16 @@ namespace type {
              */
             virtual const ListType *list() const;
 
+            /** Safe DictType* caster (alternative to RTTI)
+             * @return Pointer if successful, nullptr if not
+             */
+            virtual const DictType *dict() const;
+
+            /** Safe SetType* caster (alternative to RTTI)
+             * @return Pointer if successful, nullptr if not
+             */
+            virtual const SetType *set() const;
+
             /** Lookup a method
              *
              * @return The TypeMethod class if found, throws if not found
@@ -266,10 +288,14 @@ namespace type {
                 : runtime_error("no field named " + f + " in " + r) {}
     };
 
+    /** A record field. The fields of the records defined in the headers
+     * are primitives, the group records of group_by() also hold a list and
+     * the records of zip() hold the elements of two lists
+     */
     struct RecordField
     {
         string name;
-        const PrimitiveType *type;
+        const Type *type;
     };
 
     class UnmatchingFieldSignature : public runtime_error
@@ -294,7 +320,7 @@ namespace type {
              * @return The resulting type.
              * @throw NoSuchFieldError if no field with the given name is found
              */
-            virtual const PrimitiveType *dot(const string &) const;
+            virtual const Type *dot(const string &) const;
 
             virtual string str() const {
                 return str_;
@@ -326,6 +352,12 @@ namespace type {
              *
              */
             bool matches(const RecordType *) const;
+
+            /** Returns true if all the fields are primitives (i.e. if the
+             * record can be given on the command line and written as a
+             * constant)
+             */
+            bool flat() const;
         protected:
             RecordType(const string &name, const field_vector &m)
                 : str_(name), fields_(m) {}
@@ -369,6 +401,91 @@ namespace type {
             const SingleType *elem_;
     };
 
+    /** A dictionary type, mapping primitives to single values (written as
+     * e.g. string->person)
+     *
+     * keys() and values() return the entries in key order, so that the
+     * output of a template doesn't depend on the order that the entries
+     * were added in.
+     */
+    class DictType : public Type
+    {
+            friend class TypeFactory;
+
+        public:
+            /** Returns the dictionary's key type
+             *
+             */
+            const PrimitiveType *key() const {
+                return key_;
+            }
+            /** Returns the dictionary's value type
+             *
+             */
+            const SingleType *value() const {
+                return value_;
+            }
+            virtual string str() const {
+                return str_;
+            }
+            virtual void print(ostream &os) const;
+
+            virtual const DictType *dict() const {
+                return this;
+            }
+
+            virtual void accept(TypeVisitor &v) const {
+                v.visit(this);
+            }
+        protected:
+            DictType(const PrimitiveType *k, const SingleType *v)
+                : str_(k->str() + "->" + v->str()), key_(k), value_(v) {}
+            DictType(const DictType &) = default;
+            DictType &operator=(const DictType &) = default;
+            virtual ~DictType() {}
+        private:
+            string str_;
+            const PrimitiveType *key_;
+            const SingleType *value_;
+    };
+
+    /** A set of primitives (written as e.g. string{})
+     *
+     */
+    class SetType : public Type
+    {
+            friend class TypeFactory;
+
+        public:
+            /** Returns the set's element type
+             *
+             */
+            const PrimitiveType *elem() const {
+                return elem_;
+            }
+            virtual string str() const {
+                return str_;
+            }
+            virtual void print(ostream &os) const;
+
+            virtual const SetType *set() const {
+                return this;
+            }
+
+            virtual void accept(TypeVisitor &v) const {
+                v.visit(this);
+            }
+        protected:
+            SetType(const PrimitiveType *t)
+                : str_(t->str() + "{}"), elem_(t) {}
+            SetType(const SetType &) = default;
+            SetType &operator=(const SetType &) = default;
+            virtual ~SetType() {}
+        private:
+            string str_;
+            const PrimitiveType *elem_;
+    };
+
     class TypeAlreadyDefined : public runtime_error
     {
         public:
@@ -434,7 +551,7 @@ namespace type {
                 if (!initialized_)
                     init();
                 auto it = map_.find(s);
-                return (it != map_.end()) ? it->second : nullptr;
+                return (it != map_.end()) ? it->second : get_builtin_record(s);
             }
 
             /** Returns the corresponding list type from a single type
@@ -449,6 +566,84 @@ namespace type {
                        it->second->list() : nullptr;
             }
 
+            /** Returns the record type of the groups created by group_by(),
+             * holding a key and the list of the elements with that key. The
+             * type (and its list type) is created on the first request
+             *
+             */
+            static const RecordType *get_group(const PrimitiveType *k,
+                                               const SingleType *e) {
+                string name = "group_" + k->str() + "_" + e->str();
+                RecordType::field_vector fields = {
+                    { "key", k },
+                    { "items", get_list(e) }
+                };
+
+                /* Does nothing if the type already exists */
+                add_record(name, fields);
+                return get(name)->record();
+            }
+
+            /** Returns the record type of the pairs created by zip(),
+             * holding an element of each list. The type (and its list
+             * type) is created on the first request
+             *
+             */
+            static const RecordType *get_zip(const SingleType *a,
+                                             const SingleType *b) {
+                string name = "zip_" + a->str() + "_" + b->str();
+                RecordType::field_vector fields = {
+                    { "first", a },
+                    { "second", b }
+                };
+
+                /* Does nothing if the type already exists */
+                add_record(name, fields);
+                return get(name)->record();
+            }
+
+            /** Returns the corresponding set type from a primitive type
+             *
+             * @return The type if found, else nullptr
+             */
+            static const SetType *get_set(const PrimitiveType *t) {
+                if (!initialized_)
+                    init();
+                auto it = map_.find(t->str() + "{}");
+                return (it != map_.end()) ?
+                       it->second->set() : nullptr;
+            }
+
+            /** Returns the dictionary type with the given key and value
+             * types. The type is created on the first request
+             *
+             */
+            static const DictType *get_dict(const PrimitiveType *k,
+                                            const SingleType *v) {
+                if (!initialized_)
+                    init();
+                auto it = map_.find(k->str() + "->" + v->str());
+                if (it != map_.end())
+                    return it->second->dict();
+
+                DictType *t = new DictType(k, v);
+                map_[t->str()] = t;
+                setup_dict_methods(t);
+                return t;
+            }
+
+            /** Returns the dictionary types that have been created
+             *
+             */
+            static vector<const DictType *> get_dicts() {
+                vector<const DictType *> v;
+                for (auto it = map_.begin(); it != map_.end(); ++it) {
+                    if (it->second->dict())
+                        v.push_back(it->second->dict());
+                }
+                return v;
+            }
+
             static vector<const RecordType *>get_records() {
                 vector<const RecordType *> v;
                 for (auto it = map_.begin(); it != map_.end(); ++it) {
@@ -484,6 +679,7 @@ namespace type {
 
                 if (it == map_.end()) {
                     map_[t->str()] = t;
+                    setup_list_methods(t);
                     return t;
                 } else {
                     delete t;
@@ -491,6 +687,56 @@ namespace type {
                 }
             }
 
+            /** Returns the group or zip record (or list of them) named by
+             * the string, e.g. group_string_person or zip_int_person,
+             * creating it if needed. Returns nullptr if the string doesn't
+             * name one
+             *
+             */
+            static const Type *get_builtin_record(const string &s) {
+                bool list = s.size() > 2 && s.compare(s.size() - 2, 2, "[]") == 0;
+                string name = list ? s.substr(0, s.size() - 2) : s;
+                const RecordType *r = nullptr;
+
+                auto single = [](const string &n) -> const SingleType * {
+                    auto it = map_.find(n);
+                    return it != map_.end() ? it->second->single() : nullptr;
+                };
+
+                if (name.compare(0, 6, "group_") == 0) {
+                    for (auto k : { "bool", "int", "string" }) {
+                        string prefix = string("group_") + k + "_";
+                        const SingleType *e;
+
+                        if (name.compare(0, prefix.size(), prefix) == 0 &&
+                                (e = single(name.substr(prefix.size()))))
+                            r = get_group(map_[k]->primitive(), e);
+                    }
+                } else if (name.compare(0, 4, "zip_") == 0) {
+                    /* The element types' names may hold underscores too */
+                    for (auto i = name.find('_', 4); i != string::npos && !r;
+                            i = name.find('_', i + 1)) {
+                        auto a = single(name.substr(4, i - 4));
+                        auto b = single(name.substr(i + 1));
+
+                        if (a && b)
+                            r = get_zip(a, b);
+                    }
+                }
+
+                if (r == nullptr)
+                    return nullptr;
+                return list ? get_list(r) : static_cast<const Type *>(r);
+            }
+
+            static SetType *add_set(const PrimitiveType *p) {
+                SetType *t = new SetType(p);
+
+                map_[t->str()] = t;
+                setup_set_methods(t);
+                return t;
+            }
+
             static void add_primitive(PrimitiveType *p)
             {
                 map_[p->str()] = p;
@@ -544,6 +790,10 @@ namespace type {
                 sl->add_method(TypeMethod("join", s, s_v));
                 sl->add_method(TypeMethod("size", i, e_v));
                 sl->add_method(TypeMethod("sort", sl, b_v));
+
+                add_set(b);
+                add_set(i);
+                add_set(s);
             }
 
             static void setup_loop_record() {
@@ -561,7 +811,18 @@ namespace type {
                 vector<const Type *> e_v = { };
                 const Type *sl = get_list(get("string")->single());
 
-                t->add_method(TypeMethod("elems", sl, e_v));
+                if (t->flat())
+                    t->add_method(TypeMethod("elems", sl, e_v));
+            }
+
+            /** Adds the element access methods that every list has */
+            static void setup_list_methods(ListType *t) {
+                vector<const Type *> i_v = { get("int") };
+                vector<const Type *> ii_v = { get("int"), get("int") };
+
+                t->add_method(TypeMethod("at", t->elem(), i_v));
+                t->add_method(TypeMethod("from", t, i_v));
+                t->add_method(TypeMethod("slice", t, ii_v));
             }
 
             static void setup_record_list_methods(ListType *t) {
@@ -572,6 +833,32 @@ namespace type {
 
                 t->add_method(TypeMethod("size", get("int"), e_v));
                 t->add_method(TypeMethod("sort", t, sb_v));
+                t->add_method(TypeMethod("sort_by", t, sb_v, true));
+            }
+
+            static void setup_set_methods(SetType *t) {
+                vector<const Type *> e_v = { };
+                vector<const Type *> e_t = { t->elem() };
+                vector<const Type *> s_t = { t };
+
+                t->add_method(TypeMethod("difference", t, s_t));
+                t->add_method(TypeMethod("has", get("bool"), e_t));
+                t->add_method(TypeMethod("intersection", t, s_t));
+                t->add_method(TypeMethod("list", get_list(t->elem()), e_v));
+                t->add_method(TypeMethod("size", get("int"), e_v));
+                t->add_method(TypeMethod("union", t, s_t));
+            }
+
+            static void setup_dict_methods(DictType *t) {
+                vector<const Type *> e_v = { };
+                vector<const Type *> k_v = { t->key() };
+
+                t->add_method(TypeMethod("get", t->value(), k_v));
+                t->add_method(TypeMethod("has", get("bool"), k_v));
+                t->add_method(TypeMethod("keys", get_list(t->key()), e_v));
+                t->add_method(TypeMethod("size", get("int"), e_v));
+                t->add_method(TypeMethod("values", get_list(t->value()),
+                                         e_v));
             }
 
             static map<string, Type *> map_;
@@ -15,13 +15,14 @@ syn keyword tglHeaderKeyword arg record contained
 syn keyword tglHeaderItemKeyword cmd info default contained
 
 syn keyword tglControlKeyword with if elif else
- \ for endif endfor in create contained
+ \ for endif endfor in create macro endmacro call memo endmemo break continue contained
 
 " Types
 syn keyword tglTypes bool int string contained
 
 " Functions
-syn keyword tglFunction filter map contained
+syn keyword tglFunction all any count distinct filter group_by index_by map max
+ \ min reduce set sum unique zip contained
 
 " Primitive values
 syn keyword tglBoolean true false contained